@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include "core/Buffer.h"
+#include "utils/TypeConnect.h"
+
+/*线协议编解码
+
+两种协议并存，连接建立后由客户端发的第一段字节决定：
+
+1) 文本协议（老客户端，默认）：一行一个 JSON，'\n' 结尾；
+
+2) 二进制协议：客户端连上后先发 4 字节握手魔数 "NBC\x01"，服务端原样回 4 字节确认，
+   之后双方都按帧收发（整数一律网络字节序/大端）：
+
+   +-----------+-----------+----------------------+
+   | u32 len   | u8 opcode | payload (len-1 字节)  |
+   +-----------+-----------+----------------------+
+   len = 1 + payload 长度（不含自己这 4 字节）
+
+   opcode           请求 payload                     成功回包
+   OP_JSON   0x01   一条 JSON 请求（任意 cmd）         OP_JSON，JSON 回包
+   OP_ECHO   0x02   msg 原始字节                      OP_ECHO，data 原始字节
+   OP_SEND   0x03   text 原始字节                     OP_CHAT（广播给房间里所有人）
+   OP_CHAT   0x04   -                                u32 roomId | i64 id | u32 fromId | i64 ts |
+                                                     u16 nameLen | name | text（剩余全部）
+   OP_HIST   0x05   u32 limit                        OP_HIST_RESP
+                    [| i64 before_id | i64 after_id]  （游标翻页，可选，不用的填 0）
+   OP_HIST_RESP 0x06 -                               u32 roomId | u32 count | count 条：
+                                                     i64 id | u32 fromId | i64 ts |
+                                                     u16 nameLen | name | u32 textLen | text
+   OP_PING   0x07   空                                OP_PONG，空
+
+   紧凑格式只用在成功路径上；失败（未登录、参数错误……）一律回 OP_JSON，内容和文本协议一样。
+
+热点命令（echo / send_msg / get_history）走二进制时不用解析 JSON 文本，
+回包也不用序列化成 JSON 文本。
+
+心跳：文本协议发 {"cmd":"ping"}，二进制发 OP_PING（或 OP_JSON 里的 ping）。
+不带其它字段的心跳由 reactor 线程直接回 pong，不进线程池，也不解析 JSON。
+
+停服 / 热重启时服务端会主动推一条 {"ok":true,"cmd":"shutdown","reconnect":true,"broadcast":true}
+（二进制协议是 OP_JSON 帧），之后不再处理这个连接的新请求，已经在处理的回完就断开，客户端应当重连。*/
+namespace chat {
+
+using json = nlohmann::json;
+using WireProtocol = utils::WireProtocol;
+
+// 二进制握手魔数
+constexpr char   kBinaryMagic[4] = {'N', 'B', 'C', '\x01'};
+constexpr size_t kFrameHeaderLen = 4;
+// 单帧上限，超过当作非法数据直接断开，防止恶意长度把内存撑爆
+constexpr size_t kMaxFrameLen    = 16 * 1024 * 1024;
+
+enum Opcode : uint8_t {
+    OP_TEXT      = 0x00,   // 不是真的 opcode：表示这条请求来自文本协议
+    OP_JSON      = 0x01,
+    OP_ECHO      = 0x02,
+    OP_SEND      = 0x03,
+    OP_CHAT      = 0x04,
+    OP_HIST      = 0x05,
+    OP_HIST_RESP = 0x06,
+    OP_PING      = 0x07,
+    OP_PONG      = 0x08,
+};
+
+// 根据连接开头的字节判断协议；数据还不够判断时返回 Unknown
+WireProtocol detectProtocol(const char* data, size_t len);
+
+enum class FrameStatus { Ok, NeedMore, Bad };
+
+// 从 inbuf 里取一帧（只移动读下标）；Bad 表示长度非法，调用方应当断开连接
+FrameStatus takeFrame(Buffer& inbuf, uint8_t& op, std::string& payload);
+
+// 把一帧二进制请求还原成和文本协议一样的 JSON 请求对象；payload 格式不对返回 false
+bool decodeRequest(uint8_t op, const std::string& payload, json& req);
+
+// 回包编码：文本协议一行 JSON；二进制协议按请求的 opcode 选紧凑格式
+std::string encodeTextLine(const json& resp);
+std::string encodeBinaryResponse(uint8_t reqOp, const json& resp);
+// send_msg 的广播包（OP_CHAT 帧）
+std::string encodeChatFrame(const json& resp);
+
+// 是不是一条最简单的心跳（{"cmd":"ping"}，允许空白；OP_PING 帧）：只做字节比较，不解析 JSON
+bool isPing(uint8_t op, const char* data, size_t len);
+// 心跳回包；reqOp 为 OP_TEXT 时是一行文本
+std::string encodePong(uint8_t reqOp);
+// 服务端主动推的通知（不对应哪条请求，比如停服）：文本协议一行 JSON，二进制协议 OP_JSON 帧
+std::string encodePush(WireProtocol proto, const json& msg);
+
+}
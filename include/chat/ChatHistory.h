@@ -2,21 +2,39 @@
 
 #include <nlohmann/json.hpp>
 #include <atomic>
+#include <cstdint>
+#include <string>
 
 namespace chat {
 
 using json = nlohmann::json;
 
-// 供 send_msg 调：保存单条消息到 DB（失败不影响主流程）
-void SaveMessage(int roomId,
+// 分配一个新消息 id（进程内单调递增，总是 > 0）；第一次调用时从启动时间和 DB 的 MAX(id)
+// 里较大的那个往后起步，DB 连不上也能分配
+int64_t NextMessageId();
+
+// 供 send_msg 调：追加到房间的内存环（get_history 马上能看到），再交给 MessageWriter 异步批量落库，
+// 不阻塞（失败不影响主流程）。ts 是发送时间（秒），返回 false 表示这条不会落库（写入队列满了 / 没启动）
+bool SaveMessage(int64_t id,
+                 int roomId,
                  int userId,
                  const std::string& username,
-                 const std::string& text);
+                 const std::string& text,
+                 int64_t ts);
 
-// 供 get_history 调：带 Redis 缓存 + 互斥锁防缓存击穿
+// 供 get_history 调：从房间的内存环里拷贝最近 limit 条（最新在前），冷房间第一次读时从 DB 填环
 // 成功返回 true，historyOut 里填好 JSON 数组
 bool GetHistoryWithCache(int roomId,
                          int limit,
                          json& historyOut);
 
+// 供 get_history 带游标时调：beforeId > 0 往前翻（id < beforeId 的最新 limit 条），
+// afterId > 0 往后追（id > afterId 的最老 limit 条），结果都是最新在前；两个都是 0 等同于 GetHistoryWithCache。
+// 环里有的直接给，更老的走 Redis 页缓存（按游标做 key）+ messages(room_id, id) 上的 keyset 查询
+bool GetHistoryPage(int roomId,
+                    int limit,
+                    int64_t beforeId,
+                    int64_t afterId,
+                    json& historyOut);
+
 }
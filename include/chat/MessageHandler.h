@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <nlohmann/json.hpp>
 #include "chat/AuthService.h"
 #include "SmsService.h"
@@ -8,12 +9,73 @@
 
 using Connection = utils::Connection;
 
+/*业务处理结果：回包内容 + 路由方式
+Server 直接看 route / roomId 决定怎么投递，不用去回包里找 close / broadcast 字段；
+body 还是 JSON 对象，由 Server 按连接的协议编码（文本一行 JSON / 二进制帧）。*/
+struct HandlerResult {
+    enum class Route {
+        Reply,            // 只回给发请求的连接
+        Broadcast,        // 广播给 roomId 房间里的所有人（包括自己）
+        ReplyThenClose,   // 回给自己，写完就断开（quit）
+    };
+
+    Route          route{Route::Reply};
+    int            roomId{0};   // 只有 Broadcast 用
+    nlohmann::json body;
+
+    HandlerResult() = default;
+    // 普通回包：大部分分支直接 return resp 就行
+    // （参数写成 json&&，return 局部变量时才会走移动而不是拷贝）
+    HandlerResult(nlohmann::json&& b) : body(std::move(b)) {}
+    HandlerResult(const nlohmann::json& b) : body(b) {}
+
+    static HandlerResult broadcast(int roomId, nlohmann::json b) {
+        HandlerResult r(std::move(b));
+        r.route  = Route::Broadcast;
+        r.roomId = roomId;
+        return r;
+    }
+    static HandlerResult closeAfter(nlohmann::json b) {
+        HandlerResult r(std::move(b));
+        r.route = Route::ReplyThenClose;
+        return r;
+    }
+};
+
 class MessageHandler
 {
 public:
-    std::string handleMessage(Connection& c, const std::string& line);
+    // 处理一条已经解析好的请求
+    HandlerResult handleRequest(Connection& c, const nlohmann::json& req);
+    // 文本协议：解析一行 JSON 再交给 handleRequest（解析失败也返回错误回包）
+    HandlerResult handleLine(Connection& c, const std::string& line);
 
 private:
+    friend struct CommandTable;   // 命令表定义在 MessageHandler.cpp 里
+
+    using CommandFn = HandlerResult (MessageHandler::*)(Connection& c, const nlohmann::json& req);
+    // 一条命令：名字、是否要求先登录、处理函数
+    struct Command {
+        std::string_view name;
+        bool             needAuth;
+        CommandFn        handle;
+    };
+    // O(1) 查命令表，找不到返回 nullptr
+    static const Command* findCommand(std::string_view name);
+
+    // ===== 每个命令一个处理函数 =====
+    HandlerResult cmdLogin(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdRegister(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdUpdateName(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdResetPass(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdJoinRoom(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdSendMsg(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdGetHistory(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdEcho(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdUpper(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdPing(Connection& c, const nlohmann::json& req);
+    HandlerResult cmdQuit(Connection& c, const nlohmann::json& req);
+
     AuthService auth_;
     SmsService  sms_;   // 新增：短信服务
 };
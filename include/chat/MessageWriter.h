@@ -0,0 +1,113 @@
+#pragma once
+#include "core/BoundedQueue.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace chat {
+
+/*聊天消息的异步批量落库（write-behind）
+
+send_msg 只把消息放进一个有界队列就返回，不碰 MySQL；
+几个专门的写线程从队列里攒批：攒够 kMaxBatchRows 行 / kMaxBatchBytes 字节，
+或者这一批的第一条已经等了 kFlushDelayMs，就用预处理的多行 INSERT 写下去
+（语句缓存在连接上，不用每次解析 SQL，正文也不用转义；没攒满的批按 2 的幂拆成几条执行）。
+一批只占用一个连接池里的连接，写完马上还回去，每秒几千条消息也只要几次往返。
+
+- 内存有界：队列满了（DB 跟不上）新消息直接丢，记在 dropped 里，不阻塞业务线程；
+- 写失败重试 kMaxRetries 次（已经写进去的部分不重写），还不行剩下的丢掉，也记在 dropped 里；
+- 从入队到写进 DB 超过 kLateMs 的行记在 late 里（DB 变慢的信号）；
+- 几个写线程各写各的批，DB 里的 id 不是按顺序出现的：durableBelow 告诉调用方某个房间
+  哪个 id 以下已经不会再冒出新行，翻页缓存只缓存这条线以下的页；
+- stop() 会把队列里剩下的全部写完再返回（停服时在 Server::stop 之后调用）。*/
+class MessageWriter {
+public:
+    static MessageWriter& Instance();
+
+    // 启动写线程（DB 连接池初始化之后调用一次）
+    bool start(size_t writerThreads = 2, size_t queueCapacity = 65536);
+    // 写完队列里剩下的消息，停掉写线程
+    void stop();
+
+    // 不阻塞：没启动、已经停了或者队列满了返回 false（这条消息不会落库）
+    // id 由调用方分配（见 NextMessageId），原样写进 DB
+    bool enqueue(int64_t id, int roomId, int userId, std::string username, std::string text,
+                 int64_t ts);
+
+    // roomId 这个房间还没落库（排队中 / 正在写）的消息里最小的 id，没有的话是 INT64_MAX。
+    // 比它小的 id 要么已经写进 DB，要么已经丢了，从 DB 查出来的这一段以后不会再多出消息。
+    // 调用方要在查 DB 之前取：查的过程中落库的消息会把这条线往上推
+    int64_t durableBelow(int roomId) const;
+
+    struct Stats {
+        size_t   queued;    // 排队等待写入的行数
+        uint64_t written;   // 已经写进 DB 的行数
+        uint64_t batches;   // 写进 DB 的批次数（一批可能拆成几条 INSERT）
+        uint64_t dropped;   // 没能落库的行数（队列满、没启动、写失败）
+        uint64_t late;      // 入队到落库超过 kLateMs 的行数
+    };
+    Stats stats() const;
+
+    static constexpr size_t  kMaxBatchRows  = 512;   // 2 的幂：攒满的一批正好一条预处理 INSERT
+    static constexpr size_t  kMaxBatchBytes = 512 * 1024;   // 远小于 MySQL 默认的 max_allowed_packet
+    static constexpr int64_t kFlushDelayMs  = 5;
+    static constexpr int64_t kLateMs        = 1000;
+    static constexpr int     kMaxRetries    = 2;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingMessage {
+        int64_t id{0};
+        int roomId{0};
+        int userId{0};
+        std::string username;
+        std::string text;
+        int64_t ts{0};                 // 发送时间（秒），写成 created_at，晚写入也不影响历史里的时间
+        Clock::time_point enqueuedAt;
+    };
+
+    MessageWriter() = default;
+    ~MessageWriter();
+    MessageWriter(const MessageWriter&)            = delete;
+    MessageWriter& operator=(const MessageWriter&) = delete;
+
+    void writerLoop(size_t index);
+    // 从队列里攒一批：先等第一条（最多 waitFor），之后按行数 / 字节数 / 截止时间收尾
+    bool collectBatch(std::vector<PendingMessage>& batch, Clock::duration waitFor);
+    void flushBatch(std::vector<PendingMessage>& batch);
+    void countDropped(size_t n, const char* reason);
+    // 入队前登记、写完（或者丢掉）之后注销，durableBelow 靠它算
+    void markPending(int roomId, int64_t id);
+    void unmarkPending(int roomId, int64_t id);
+
+    // 按房间记还没落库的 id
+    static constexpr size_t kPendingShards = 16;
+    struct PendingShard {
+        std::mutex mtx;
+        std::unordered_map<int, std::multiset<int64_t>> rooms;
+    };
+    PendingShard& pendingShardOf(int roomId) const {
+        return pending_[static_cast<size_t>(roomId) % kPendingShards];
+    }
+
+    std::unique_ptr<BoundedQueue<PendingMessage>> queue_;
+    std::vector<std::thread> writers_;
+    std::atomic<bool> running_{false};
+    mutable std::array<PendingShard, kPendingShards> pending_;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> late_{0};
+};
+
+}
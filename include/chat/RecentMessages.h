@@ -0,0 +1,88 @@
+#pragma once
+#include <nlohmann/json.hpp>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace chat {
+
+using json = nlohmann::json;
+
+/*每个房间最近 kCapacity 条消息的内存环（get_history 的热路径）
+
+- send_msg 时 append：新消息直接进环，最老的一条被挤掉，不需要 TTL，也不会读到过期数据；
+- 房间第一次被读时从 DB 拉最近 kCapacity 条 warm 进来；在那之前 append 的消息先攒在环里，
+  warm 时按 id 和 DB 里的合并去重（落库是异步的，DB 里可能还没有它们）；
+- get 任意 limit（<= kCapacity）都从同一个环里拷贝，不再按 limit 各存一份缓存；
+- getPage 按 before_id / after_id 游标翻页：只有环里的数据足够回答这一页时才返回 true，
+  否则（翻到了环外面更老的消息）由调用方去 DB 查。
+
+条目就是 get_history 回包里 history 数组的元素（id / fromId / fromName / text / ts / roomId），
+顺序是最新在前。房间按 roomId 分片加锁，不同房间互不影响。
+
+最多保留 kMaxRooms 个房间的环，超了按最近使用淘汰（房间号是客户端给的，不设上限内存会一直涨）；
+被淘汰的房间下次读时重新 warm。*/
+class RecentMessages {
+public:
+    static constexpr size_t kCapacity = 200;
+    static constexpr size_t kMaxRooms = 4096;
+
+    static RecentMessages& Instance();
+
+    // 房间已经 warm 过：拷贝最近 limit 条（最新在前）到 out，返回 true；没 warm 过返回 false
+    bool get(int roomId, int limit, json& out);
+
+    // 游标翻页（最新在前）：beforeId > 0 取 id < beforeId 的最新 limit 条，
+    // afterId > 0 取 id > afterId 的最老 limit 条，两个都是 0 等同于 get。
+    // 房间没 warm 过，或者这一页有一部分在环外面（更老的消息已经被挤掉了）返回 false
+    bool getPage(int roomId, int limit, int64_t beforeId, int64_t afterId, json& out);
+
+    // 用 DB 里最近的若干条（最新在前）填充房间；已经 warm 过的房间不动，返回 true。
+    // durableBelow 是查 DB 之前这个房间已经全部落库的 id 线（见 MessageWriter::durableBelow）：
+    // 还没落库的消息不全在环里（环被淘汰过，那之前 append 的没了）时 DB 里也缺它们，
+    // 这时不 warm，返回 false，调用方这次直接用 DB 的结果
+    bool warm(int roomId, const json& newestFirst, int64_t durableBelow);
+
+    // 追加一条新消息（item 格式同 history 元素）
+    void append(int roomId, json item);
+
+private:
+    RecentMessages() = default;
+
+    struct Ring {
+        std::vector<json> items;   // 环形存放，head 指向最老的一条
+        size_t head{0};
+        bool warmed{false};
+        bool complete{false};      // 房间全部消息都在环里（warm 时 DB 里不满一环，且之后没挤掉过）
+        uint64_t lastUsed{0};      // 分片内的使用序号，淘汰时挑最小的
+
+        size_t size() const { return items.size(); }
+        // 第 i 新的一条（i = 0 是最新）
+        const json& newest(size_t i) const {
+            return items[(head + items.size() - 1 - i) % items.size()];
+        }
+        json& newest(size_t i) {
+            return items[(head + items.size() - 1 - i) % items.size()];
+        }
+        void push(json item);
+    };
+
+    static constexpr size_t kShardCount = 16;
+    static constexpr size_t kMaxRoomsPerShard = kMaxRooms / kShardCount;
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<int, Ring> rooms;
+        uint64_t tick{0};
+    };
+    std::array<Shard, kShardCount> shards_;
+
+    Shard& shardOf(int roomId) {
+        return shards_[static_cast<unsigned>(roomId) % kShardCount];
+    }
+    // 取（没有就建）房间的环并记一次使用；建新环时分片满了先淘汰最久没用的。调用方持有 sh.mtx
+    Ring& touch(Shard& sh, int roomId);
+};
+
+}
@@ -1,47 +1,114 @@
-#pragma once 
+#pragma once
 
+#include <array>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 
+// 房间成员的句柄：fd 用来找到连接所在的 loop 和 conns 里的条目，
+// connId 用来确认这个 fd 没有被别的新连接复用
+struct RoomMember {
+    int      fd{-1};
+    uint64_t connId{0};
+};
+
+/*房间成员索引：roomId -> 成员列表
+
+广播只需要遍历房间里的成员，而不是扫描全服所有连接。
+
+并发设计（分片锁 + 写时复制快照）：
+- 房间按 roomId 散列到 kShardCount 个分片，每个分片一把锁，不同房间的进出互不影响；
+- 每个房间的成员列表是不可变的 shared_ptr<const vector>：
+  进/出房间时在分片锁内拷贝一份、修改后整体替换指针（写时复制，房间上限 100 人，拷贝很便宜）；
+- 广播（读）只在锁内拷贝一下 shared_ptr 就放锁，之后在锁外遍历快照，
+  遍历再慢也不会挡住别人进出房间，进出房间也不会改到正在被遍历的那份列表。*/
 class RoomManager
 {
+public:
+    using MemberList     = std::vector<RoomMember>;
+    using MemberSnapshot = std::shared_ptr<const MemberList>;
+
 private:
     RoomManager() = default;
 
-    std::mutex  mtx_;
-    // roomId -> 人数
-    std::unordered_map<int, int> roomCounts_;
+    static constexpr size_t kShardCount = 16;
+
+    struct Shard {
+        std::mutex mtx;
+        // roomId -> 成员快照（空房间直接删掉）
+        std::unordered_map<int, MemberSnapshot> rooms;
+    };
+    std::array<Shard, kShardCount> shards_;
+
+    Shard& shardOf(int roomId) {
+        return shards_[static_cast<unsigned>(roomId) % kShardCount];
+    }
+
 public:
     static RoomManager& Instance(){
         static RoomManager inst;
         return inst;
     }
 
-    // 尝试进入房间：如果人数 < maxSize 则 +1 并返回 true，否则返回 false
-    bool tryEnterRoom(int roomId, int maxSize){
-         std::lock_guard<std::mutex> lock(mtx_);
-        int& cnt = roomCounts_[roomId];
-        if(cnt >= maxSize) return false;
-        ++cnt;
+    // 尝试进入房间：如果人数 < maxSize 则加入成员列表并返回 true，否则返回 false
+    bool tryEnterRoom(int roomId, const RoomMember& member, int maxSize){
+        Shard& sh = shardOf(roomId);
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        MemberSnapshot& cur = sh.rooms[roomId];
+        if (cur) {
+            // 已经在房间里了（比如重复登录），不要重复加
+            for (const auto& m : *cur) {
+                if (m.fd == member.fd && m.connId == member.connId) return true;
+            }
+        }
+        size_t size = cur ? cur->size() : 0;
+        if (static_cast<int>(size) >= maxSize) {
+            if (!cur) sh.rooms.erase(roomId);
+            return false;
+        }
+
+        auto next = cur ? std::make_shared<MemberList>(*cur)
+                        : std::make_shared<MemberList>();
+        next->push_back(member);
+        cur = std::move(next);
         return true;
     }
 
-    // 离开房间：人数 -1（不要减到负数）
-    void leaveRoom(int roomId){
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto it = roomCounts_.find(roomId);
-        if(it == roomCounts_.end()) return;
-        if (it->second > 0) {
-            --it->second;
+    // 离开房间：把这个连接从成员列表里删掉
+    void leaveRoom(int roomId, const RoomMember& member){
+        Shard& sh = shardOf(roomId);
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        auto it = sh.rooms.find(roomId);
+        if(it == sh.rooms.end()) return;
+
+        const MemberList& cur = *it->second;
+        auto next = std::make_shared<MemberList>();
+        next->reserve(cur.size());
+        for (const auto& m : cur) {
+            if (m.fd == member.fd && m.connId == member.connId) continue;
+            next->push_back(m);
+        }
+        if (next->empty()) {
+            sh.rooms.erase(it);
+        } else {
+            it->second = std::move(next);
         }
-        return;
     }
 
     // 获取房间人数
     int getRoomSize(int roomId){
-        std::lock_guard<std::mutex> lock(mtx_);
-        auto it = roomCounts_.find(roomId);
-        if(it == roomCounts_.end()) return 0;
+        MemberSnapshot snap = members(roomId);
+        return snap ? static_cast<int>(snap->size()) : 0;
+    }
+
+    // 取房间成员快照（可能为 nullptr）；拿到之后锁外随便遍历
+    MemberSnapshot members(int roomId){
+        Shard& sh = shardOf(roomId);
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        auto it = sh.rooms.find(roomId);
+        if(it == sh.rooms.end()) return nullptr;
         return it->second;
     }
-};
\ No newline at end of file
+};
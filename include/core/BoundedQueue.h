@@ -0,0 +1,117 @@
+#pragma once
+#include "MpmcRing.h"
+#include "EventCount.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/*SafeQueue 的无锁版本：MpmcRing 外面包一层阻塞语义
+
+- tryPush / tryPop：不阻塞，满了 / 空了直接返回 false；
+- Safepush / Safepop：和 SafeQueue 同名同语义（满了等、空了等，Stop 之后 push 失败，
+  pop 把剩下的取完才返回 false），换类型就能直接替换；
+- popFor / popUntil：带截止时间的 pop，到点还没取到返回 false；
+- 等待时先自旋 kSpinCount 次（队列通常很快就有东西），还不行才在 EventCount 上睡；
+- 生产者和消费者各睡在自己的 EventCount 上：pop 只有真的有生产者在等“不满”时才会发唤醒，
+  不像 SafeQueue 那样一把 condvar 两头共用、每次 pop 都 notify。
+
+容量构造时定死（向上取 2 的幂），不支持 SafeQueue 的 SetMaxEvent。*/
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity = 1024) : ring_(capacity) {}
+
+    BoundedQueue(const BoundedQueue&)            = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity()   const { return ring_.capacity(); }
+    size_t sizeApprox() const { return ring_.sizeApprox(); }
+
+    template<class U>
+    bool tryPush(U&& value) {
+        if (stop_.load(std::memory_order_acquire)) return false;
+        if (!ring_.tryPush(std::forward<U>(value))) return false;
+        notEmpty_.notifyOne();
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        if (!ring_.tryPop(out)) return false;
+        notFull_.notifyOne();
+        return true;
+    }
+
+    // 阻塞入队；已经 Stop 返回 false
+    template<class U>
+    bool Safepush(U&& value) {
+        // tryPush 只在抢到槽位后才移动 value，失败重试时 value 还是完整的
+        return waitUntil(notFull_, [&] { return tryPush(std::forward<U>(value)); },
+                         [&] { return stop_.load(std::memory_order_acquire); }, nullptr);
+    }
+
+    // 阻塞出队；队列空且已 Stop 返回 false
+    bool Safepop(T& out) {
+        return waitUntil(notEmpty_, [&] { return tryPop(out); },
+                         [&] { return stop_.load(std::memory_order_acquire); }, nullptr);
+    }
+
+    bool popUntil(T& out, std::chrono::steady_clock::time_point deadline) {
+        return waitUntil(notEmpty_, [&] { return tryPop(out); },
+                         [&] { return stop_.load(std::memory_order_acquire); }, &deadline);
+    }
+
+    template<class Rep, class Period>
+    bool popFor(T& out, std::chrono::duration<Rep, Period> timeout) {
+        return popUntil(out, std::chrono::steady_clock::now() + timeout);
+    }
+
+    void Stop() {
+        stop_.store(true, std::memory_order_seq_cst);
+        notEmpty_.notifyAll();
+        notFull_.notifyAll();
+    }
+
+private:
+    static constexpr int kSpinCount = 64;
+
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // attempt 成功返回 true；stopped 为真且 attempt 失败返回 false；deadline 非空时到点返回 false
+    template<class Attempt, class Stopped>
+    bool waitUntil(EventCount& ec, Attempt&& attempt, Stopped&& stopped,
+                   const std::chrono::steady_clock::time_point* deadline) {
+        for (int i = 0; i < kSpinCount; ++i) {
+            if (attempt()) return true;
+            if (stopped()) return false;
+            cpuRelax();
+        }
+        for (;;) {
+            // 准备睡之前再试一次：prepareWait 之后的 notify 一定会把我们叫醒
+            uint32_t key = ec.prepareWait();
+            if (attempt()) {
+                ec.cancelWait();
+                return true;
+            }
+            if (stopped()) {
+                ec.cancelWait();
+                return false;
+            }
+            if (deadline == nullptr) {
+                ec.commitWait(key);
+            } else if (!ec.commitWaitUntil(key, *deadline)) {
+                return attempt();   // 超时前最后再看一眼
+            }
+        }
+    }
+
+    MpmcRing<T>       ring_;
+    std::atomic<bool> stop_{false};
+    EventCount        notEmpty_;   // 消费者睡在这里
+    EventCount        notFull_;    // 生产者睡在这里
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+
+/*连接的输入缓冲区（参考 muduo::net::Buffer）
+
++-------------------+------------------+------------------+
+| prependable bytes |  readable bytes  |  writable bytes  |
+|                   |     (CONTENT)    |                  |
++-------------------+------------------+------------------+
+|                   |                  |                  |
+0      <=      readerIndex_   <=   writerIndex_    <=     size
+
+- 取走数据只移动 readerIndex_，不像 std::string::erase(0, n) 那样每次整体搬移；
+- 写空间不够时优先把可读数据挪回头部复用空间（整段只挪一次），实在不够才扩容；
+- 头部预留 kCheapPrepend 字节，可以在不拷贝正文的情况下往前面塞长度头之类的东西；
+- readFd 用 readv + 栈上 64KB extrabuf，一次系统调用就能读完大块数据，
+  又不用给每个连接都预先分配很大的缓冲区。*/
+class Buffer
+{
+public:
+    static constexpr size_t kCheapPrepend = 8;
+    static constexpr size_t kInitialSize  = 1024;
+
+    explicit Buffer(size_t initialSize = kInitialSize)
+        : buffer_(kCheapPrepend + initialSize),
+          readerIndex_(kCheapPrepend),
+          writerIndex_(kCheapPrepend) {}
+
+    size_t readableBytes()    const { return writerIndex_ - readerIndex_; }
+    size_t writableBytes()    const { return buffer_.size() - writerIndex_; }
+    size_t prependableBytes() const { return readerIndex_; }
+
+    // 可读数据的起始地址
+    const char* peek() const { return begin() + readerIndex_; }
+
+    // 从 start 开始找 '\n'，找不到返回 nullptr
+    const char* findEOL(const char* start) const {
+        const void* eol = std::memchr(start, '\n', static_cast<size_t>(beginWrite() - start));
+        return static_cast<const char*>(eol);
+    }
+    const char* findEOL() const { return findEOL(peek()); }
+
+    // 取走 len 字节（只移动下标）
+    void retrieve(size_t len) {
+        if (len < readableBytes()) {
+            readerIndex_ += len;
+        } else {
+            retrieveAll();
+        }
+    }
+    void retrieveUntil(const char* end) { retrieve(static_cast<size_t>(end - peek())); }
+    void retrieveAll() {
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend;
+    }
+    std::string retrieveAsString(size_t len) {
+        len = std::min(len, readableBytes());
+        std::string out(peek(), len);
+        retrieve(len);
+        return out;
+    }
+
+    void append(const char* data, size_t len) {
+        ensureWritableBytes(len);
+        std::copy(data, data + len, beginWrite());
+        hasWritten(len);
+    }
+    void append(const std::string& s) { append(s.data(), s.size()); }
+
+    // 往可读数据前面塞 len 字节（调用方保证 len <= prependableBytes()）
+    void prepend(const void* data, size_t len) {
+        readerIndex_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+
+    void ensureWritableBytes(size_t len) {
+        if (writableBytes() < len) makeSpace(len);
+    }
+    char*       beginWrite()       { return begin() + writerIndex_; }
+    const char* beginWrite() const { return begin() + writerIndex_; }
+    void hasWritten(size_t len)    { writerIndex_ += len; }
+
+    // 从 fd 读数据到缓冲区，返回 read 的结果；出错时 errno 写到 *savedErrno
+    ssize_t readFd(int fd, int* savedErrno);
+
+private:
+    char*       begin()       { return buffer_.data(); }
+    const char* begin() const { return buffer_.data(); }
+
+    void makeSpace(size_t len);
+
+private:
+    std::vector<char> buffer_;
+    size_t readerIndex_;
+    size_t writerIndex_;
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*EventCount：没活干的线程在 futex 上睡，代替 mutex + condition_variable
+
+用法（等待方）：
+    uint32_t key = ec.prepareWait();
+    if (还有活) { ec.cancelWait(); 去干活; }
+    else        { ec.commitWait(key); }
+通知方：先把活放好，再 notifyOne() / notifyAll()。
+
+prepareWait 之后、commitWait 之前来的通知会让 epoch_ 变化，commitWait 发现 key 过期立刻返回，
+所以不会丢唤醒；没有人在等时 notify 只是一次原子读，不做系统调用。
+
+pending_ 记录“已经发出、但被叫醒的线程还没真正醒来处理”的唤醒数。
+被唤醒的线程要等调度器给它 CPU 才会离开 commitWait，这期间 waiters_ 还没减下去，
+如果不看 pending_，生产者每提交一个任务都会再发一次 futex 唤醒系统调用。
+在途的唤醒够用时就不再发：那些线程醒来后一定会看到刚放进去的活。*/
+class EventCount {
+public:
+    uint32_t prepareWait() {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        // 和 notify 里的 fence 配对：之后对“有没有活”的检查（哪怕是 relaxed 读）一定能看到
+        // 通知方在 notify 之前放进去的东西
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_seq_cst);
+    }
+
+    void cancelWait() {
+        leave();
+    }
+
+    void commitWait(uint32_t key) {
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE,
+                      key, nullptr, nullptr, 0);
+        }
+        leave();
+    }
+
+    // 带截止时间的 commitWait：被通知返回 true，到点了还没人通知返回 false
+    bool commitWaitUntil(uint32_t key, std::chrono::steady_clock::time_point deadline) {
+        bool notified = true;
+        while (epoch_.load(std::memory_order_acquire) == key) {
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::steady_clock::duration::zero()) {
+                notified = false;
+                break;
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            struct timespec ts;
+            ts.tv_sec  = static_cast<time_t>(ns / 1000000000);
+            ts.tv_nsec = static_cast<long>(ns % 1000000000);
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE,
+                      key, &ts, nullptr, 0);
+        }
+        leave();
+        return notified;
+    }
+
+    void notifyOne() {
+        // 和 prepareWait 里的 fetch_add 配对：要么等待方看到新放进去的活，要么这里看到等待方
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int32_t waiters = waiters_.load(std::memory_order_seq_cst);
+        if (waiters == 0) return;
+        if (pending_.load(std::memory_order_seq_cst) >= waiters) return;   // 在途的唤醒已经够了
+        pending_.fetch_add(1, std::memory_order_seq_cst);
+        wake(1);
+    }
+
+    void notifyAll() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0) return;
+        wake(INT_MAX);
+    }
+
+private:
+    void wake(int n) {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE,
+                  n, nullptr, nullptr, 0);
+    }
+
+    // 不管是取消还是真的醒来，都顺手消掉一个在途唤醒
+    void leave() {
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+        int32_t p = pending_.load(std::memory_order_seq_cst);
+        while (p > 0 && !pending_.compare_exchange_weak(p, p - 1, std::memory_order_seq_cst)) {}
+    }
+
+    alignas(64) std::atomic<uint32_t> epoch_{0};
+    alignas(64) std::atomic<int32_t>  waiters_{0};
+    std::atomic<int32_t>              pending_{0};
+};
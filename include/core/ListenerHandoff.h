@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*热重启：把监听 socket 从旧进程交给新进程（Unix 域 socket + SCM_RIGHTS）
+
+旧进程启动时在 path 上开一个控制 socket；新进程启动时先去连这个 path：
+- 连上了：旧进程把监听 fd 连同端口号一起发过来，新进程直接拿来 accept，不用重新 bind，
+  内核 accept 队列里还没被接走的连接也一并归新进程；旧进程交出去之后停止 accept，排空老连接后退出；
+- 连不上（没有旧进程，或者 path 是上次崩溃留下的）：照常自己 bind。
+
+整个过程中监听 socket 一直开着，客户端重连不会被拒绝。*/
+namespace handoff {
+
+// 新进程：向旧进程要监听 fd，端口对不上或者没有旧进程返回 -1（阻塞，最多等 timeoutMs）
+int receiveListener(const std::string& path, uint16_t port, int timeoutMs = 3000);
+
+// 旧进程：在 path 上开控制 socket（非阻塞，先删掉残留的文件），失败返回 -1
+int openControlSocket(const std::string& path);
+
+// 旧进程：控制 socket 可读时调用，接一个新进程并把监听 fd 发过去；成功返回 true
+bool sendListener(int controlFd, int listenFd, uint16_t port);
+
+}
@@ -1,105 +1,229 @@
 #pragma once
-#include <fstream>
 #include <string>
+#include <string_view>
+#include <sstream>
 #include <mutex>
-#include <filesystem>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <type_traits>
+#include <algorithm>
+#include <ctime>
 #include <cstring>
+#include <cstdint>
 
+// 数值越大越严重，阈值比较直接用 >=
 enum class LogLevel{
-    INFO,
-    WARN,
-    ERROR,
-    DEBUG
+    DEBUG = 0,
+    INFO  = 1,
+    WARN  = 2,
+    ERROR = 3
 };
 
+// 编译期最低日志级别（CMake 选项 NEBULA_LOG_MIN_LEVEL）：低于它的日志宏直接编译成空，
+// 连级别判断都不会留下
+#ifndef NEBULA_LOG_MIN_LEVEL
+#define NEBULA_LOG_MIN_LEVEL 0
+#endif
 
-class Logger
-{
-private:
-    std::mutex mtx_;
+struct LogThreadBuffer;
+
+/*结构化日志的参数编码：每个参数 1 字节类型标记 + 原始字节（本机字节序）
+  'b' bool(u8) | 'i' int64 | 'u' uint64 | 'd' double | 'p' 指针(u64) | 's' u32 长度 + 字节
+字符串参数超过 kMaxString 截断，整条超过 kCapacity 后面的参数丢掉。*/
+class LogArgEncoder {
+public:
+    static constexpr size_t kCapacity  = 1024;
+    static constexpr size_t kMaxString = 256;
+
+    template<class T>
+    void put(const T& v) {
+        using U = std::decay_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            putRaw('b', static_cast<uint8_t>(v));
+        } else if constexpr (std::is_enum_v<U>) {
+            put(static_cast<std::underlying_type_t<U>>(v));
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            putRaw('i', static_cast<int64_t>(v));
+        } else if constexpr (std::is_integral_v<U>) {
+            putRaw('u', static_cast<uint64_t>(v));
+        } else if constexpr (std::is_floating_point_v<U>) {
+            putRaw('d', static_cast<double>(v));
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            putString(std::string_view(v));
+        } else if constexpr (std::is_pointer_v<U>) {
+            putRaw('p', static_cast<uint64_t>(reinterpret_cast<uintptr_t>(v)));
+        } else {
+            static_assert(std::is_void_v<T>, "unsupported structured log argument type");
+        }
+    }
+
+    const char* data() const { return buf_; }
+    size_t      size() const { return len_; }
 
-    std::ofstream info_;
-    std::ofstream warn_;
-    std::ofstream error_;
-    std::ofstream debug_;
 private:
-    Logger(){
-    // 获取可执行文件所在绝对路径
-    std::string exePath = std::filesystem::canonical("/proc/self/exe").string();
-    
-    // 得到可执行文件目录（/NebulaChat/build/）
-    auto exeDir = std::filesystem::path(exePath).parent_path();
+    template<class V>
+    void putRaw(char tag, V v) {
+        if (len_ + 1 + sizeof(v) > kCapacity) return;
+        buf_[len_++] = tag;
+        std::memcpy(buf_ + len_, &v, sizeof(v));
+        len_ += sizeof(v);
+    }
+    void putString(std::string_view s) {
+        uint32_t n = static_cast<uint32_t>(std::min(s.size(), kMaxString));
+        if (len_ + 1 + sizeof(n) + n > kCapacity) return;
+        buf_[len_++] = 's';
+        std::memcpy(buf_ + len_, &n, sizeof(n));
+        len_ += sizeof(n);
+        std::memcpy(buf_ + len_, s.data(), n);
+        len_ += n;
+    }
 
-    // 得到项目根目录（/NebulaChat）
-    auto projectRoot = exeDir.parent_path();
+    char   buf_[kCapacity];
+    size_t len_{0};
+};
 
-    auto logDir_ = projectRoot / "logs";
+/*异步日志
 
-    std::filesystem::create_directory(logDir_);
+- 每个线程第一次打日志时分到一块自己的暂存环形缓冲区（单生产者单消费者，无锁），
+  打日志只是往里 memcpy 一条记录，不加全局锁、不做系统调用；
+- 后台 flusher 线程定时（或缓冲区快满 / 出现 ERROR 时被叫醒）把所有线程的缓冲区收一遍，
+  按级别攒成四批，每个文件一次 write() 写出去；
+- 时间戳在 flusher 里格式化，同一秒内复用上一次格式化好的字符串；
+- 级别阈值在宏里、格式化消息之前判断，被过滤掉的日志不会构造 ostringstream；
+- 单个文件超过大小上限或打开时间超过轮转间隔就改名为 xxx.log.时间 并新开一个。
 
-    info_.open(logDir_ / "info.log",  std::ios::app);
-    warn_.open(logDir_ / "warn.log",  std::ios::app);
-    error_.open(logDir_ / "error.log", std::ios::app);
-    debug_.open(logDir_ / "debug.log", std::ios::app);
-    }
+阈值默认 INFO，可以用环境变量 NEBULA_LOG_LEVEL=debug|info|warn|error 或 setLevel() 调整。
 
-    ~Logger(){
-        info_.close();
-        warn_.close();
-        error_.close();
-        debug_.close();
+结构化日志（LOGF_* 宏）：调用点只记“格式串编号 + 原始参数”，不在业务线程里拼字符串。
+- 文本模式（默认）：flusher 按格式串把参数填进 "{}" / "{:x}"，和普通日志写进同一批文件；
+- 二进制模式（NEBULA_LOG_FORMAT=binary 或 setBinaryOutput(true)）：原样写进 logs/nebula.blog，
+  用 scripts/logreader.py 离线解码。文件格式见 Logger.cpp 里的 writeBinary。*/
+class Logger
+{
+public:
+    static Logger& Instance(){
+        static Logger instance;
+        return instance;
     }
 
-private:
-    /*这个是返回对应选择的fstream*/
-    std::ofstream& getFileStream(LogLevel lvl) {
-        switch (lvl) {
-            case LogLevel::INFO: return info_;
-            case LogLevel::WARN: return warn_;
-            case LogLevel::ERROR: return error_;
-            case LogLevel::DEBUG: return debug_;
-        }
-        return info_;
+    bool enabled(LogLevel lvl) const {
+        return static_cast<int>(lvl) >= level_.load(std::memory_order_relaxed);
     }
-    /*现在的作用就是在log日志里面打印出这几个字符串*/
-    std::string levelToString(LogLevel lvl) {
-        switch (lvl) {
-            case LogLevel::INFO:  return "INFO";
-            case LogLevel::WARN:  return "WARN";
-            case LogLevel::ERROR: return "ERROR";
-            case LogLevel::DEBUG: return "DEBUG";
-        }
-        return "INFO";
+    void setLevel(LogLevel lvl) { level_.store(static_cast<int>(lvl), std::memory_order_relaxed); }
+
+    // maxBytes：单个文件大小上限；intervalSec：一个文件最多写多久（秒），<= 0 表示不按时间轮转
+    void setRotation(size_t maxBytes, int intervalSec) {
+        rotateBytes_.store(maxBytes, std::memory_order_relaxed);
+        rotateIntervalSec_.store(intervalSec, std::memory_order_relaxed);
     }
+    // 结构化日志是否以二进制写出
+    void setBinaryOutput(bool on) { binaryOutput_.store(on, std::memory_order_relaxed); }
 
-    std::string timestamp() {
-        time_t now = time(nullptr);
-        tm* lt = localtime(&now);
+    void log(LogLevel level, const char* msg, size_t len);
+    void log(LogLevel level, const std::string& msg) { log(level, msg.data(), msg.size()); }
 
-        char buf[32];
-        snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
-                 lt->tm_year + 1900, lt->tm_mon + 1, lt->tm_mday,
-                 lt->tm_hour, lt->tm_min, lt->tm_sec);
+    // 登记一个结构化日志的调用点，返回格式串编号（每个调用点只登记一次）
+    uint32_t registerFormat(LogLevel level, const char* file, int line, const char* fmt);
 
-        return buf;
+    template<class... Args>
+    void logStructured(LogLevel level, uint32_t fmtId, const Args&... args) {
+        LogArgEncoder enc;
+        (enc.put(args), ...);
+        append(level, kStructured, fmtId, enc.data(), enc.size());
     }
-public:
-    static Logger& Instance(){
-     static Logger instance;
-     return instance;
-   }
 
-   void log(LogLevel level,const std::string& msg){
-    std::lock_guard<std::mutex> lock(mtx_);
+private:
+    Logger();
+    ~Logger();
+    Logger(const Logger&)            = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // 记录类型
+    static constexpr uint8_t kText       = 0;
+    static constexpr uint8_t kStructured = 1;
+
+    struct LogFile {
+        int         fd{-1};
+        std::string path;
+        size_t      size{0};        // 当前文件已写字节数
+        time_t      openedAt{0};
+    };
+
+    struct FormatInfo {
+        LogLevel    level;
+        std::string file;
+        int         line;
+        std::string fmt;
+    };
+
+    // 往当前线程的缓冲区追加一条记录
+    void append(LogLevel level, uint8_t kind, uint32_t fmtId, const char* data, size_t len);
+    LogThreadBuffer& localBuffer();
+    void requestFlush();
+    void flusherLoop();
+    // 把所有线程缓冲区里的记录收进 batches_，再按文件批量写出
+    void drainAll();
+    void writeBatch(LogFile& file, std::string& batch, time_t now);
+    // 需要的话先轮转；返回 true 表示换了新文件
+    bool maybeRotate(LogFile& file, size_t pending, time_t now);
+    void writeBinary(time_t now);
+    void openFile(LogFile& file);
+    void rotateFile(LogFile& file, time_t now);
+    // 把结构化记录按格式串还原成文本
+    void renderStructured(uint32_t fmtId, const char* args, size_t len, std::string& out);
+    // flusher 已经停了（进程退出阶段）还有人打日志：直接同步写
+    void writeDirect(LogLevel level, uint8_t kind, uint32_t fmtId, const char* msg, size_t len);
+    // 格式化 "YYYY-mm-dd HH:MM:SS"，同一秒内用缓存
+    const char* formatTime(time_t sec);
 
-    auto& file = getFileStream(level);
-    file << timestamp() << " | " << levelToString(level) << " | " << msg << "\n";
-        file.flush();  // 重要：防止崩溃时没写入文件
-   }
+private:
+    std::atomic<int> level_{static_cast<int>(LogLevel::INFO)};
+    std::atomic<size_t> rotateBytes_{64 * 1024 * 1024};
+    std::atomic<int>    rotateIntervalSec_{24 * 3600};
+    std::atomic<bool>   binaryOutput_{false};
+
+    // 所有线程的暂存缓冲区；只在线程第一次打日志、flusher 收集时加锁
+    std::mutex regMtx_;
+    std::vector<std::shared_ptr<LogThreadBuffer>> buffers_;
+
+    // 结构化日志的格式串表，下标就是编号；deque 追加时不会挪动已有元素
+    std::mutex             fmtMtx_;
+    std::deque<FormatInfo> formats_;
+
+    // flusher 线程
+    std::thread             flusher_;
+    std::mutex              wakeMtx_;
+    std::condition_variable wakeCv_;
+    std::atomic<bool>       flushPending_{false};
+    std::atomic<bool>       stop_{false};
+    std::atomic<bool>       stopped_{false};
+    std::mutex              directMtx_;   // 只给 writeDirect 用
+
+    // 下面这些只在 flusher 线程（或停掉之后持有 directMtx_ 时）访问
+    LogFile     files_[4];     // 按 LogLevel 下标：debug / info / warn / error
+    std::string batches_[4];
+    LogFile     binFile_;      // nebula.blog
+    std::string binBatch_;
+    size_t      formatsWritten_{0};   // 当前 binFile_ 里已经写过定义的格式串个数
+    time_t      cachedSec_{-1};
+    char        cachedTime_[32]{};
 };
-// 简化宏
-#define LOG_INFO(msg)  do{std::ostringstream oss; oss << msg; Logger::Instance().log(LogLevel::INFO, oss.str());} while (0);
-#define LOG_WARN(msg)  do{std::ostringstream oss; oss << msg; Logger::Instance().log(LogLevel::WARN, oss.str());} while (0);
-#define LOG_ERROR(msg)  do{std::ostringstream oss; oss << msg; Logger::Instance().log(LogLevel::ERROR, oss.str());} while (0);
-#define LOG_DEBUG(msg)  do{std::ostringstream oss; oss << msg; Logger::Instance().log(LogLevel::DEBUG, oss.str());} while (0);
 
+// 简化宏：先判断级别再格式化，被过滤掉的日志几乎没有开销；低于编译期级别的直接编译掉
+#define LOG_AT(lvl, msg) do{ if constexpr (static_cast<int>(lvl) >= NEBULA_LOG_MIN_LEVEL) { Logger& lg_ = Logger::Instance(); if (lg_.enabled(lvl)) { std::ostringstream oss; oss << msg; lg_.log(lvl, oss.str()); } } } while (0);
+#define LOG_INFO(msg)   LOG_AT(LogLevel::INFO, msg)
+#define LOG_WARN(msg)   LOG_AT(LogLevel::WARN, msg)
+#define LOG_ERROR(msg)  LOG_AT(LogLevel::ERROR, msg)
+#define LOG_DEBUG(msg)  LOG_AT(LogLevel::DEBUG, msg)
+
+// 结构化日志宏：LOGF_DEBUG("[Server::onConnRead] fd={} read {} bytes", fd, n);
+// 格式串必须是字面量；占位符 {} 按参数类型输出，{:x} 输出十六进制
+#define LOGF_AT(lvl, fmt, ...) do{ if constexpr (static_cast<int>(lvl) >= NEBULA_LOG_MIN_LEVEL) { Logger& lg_ = Logger::Instance(); if (lg_.enabled(lvl)) { static const uint32_t fmtId_ = lg_.registerFormat(lvl, __FILE__, __LINE__, fmt); lg_.logStructured(lvl, fmtId_, ##__VA_ARGS__); } } } while (0);
+#define LOGF_INFO(fmt, ...)   LOGF_AT(LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define LOGF_WARN(fmt, ...)   LOGF_AT(LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define LOGF_ERROR(fmt, ...)  LOGF_AT(LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define LOGF_DEBUG(fmt, ...)  LOGF_AT(LogLevel::DEBUG, fmt, ##__VA_ARGS__)
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+/*有界多生产者多消费者无锁环形队列（Vyukov bounded MPMC）
+
+每个槽位带一个序号 seq：
+- seq == pos        ：槽位空着，等位置为 pos 的生产者来写；
+- seq == pos + 1    ：已经写好，等位置为 pos 的消费者来读；
+- 消费者读完把 seq 设成 pos + 容量，留给下一圈的生产者。
+生产者 / 消费者各自只 CAS 一个游标（enqueuePos_ / dequeuePos_）抢位置，
+抢到之后读写槽位不需要再和别人同步，两头互不干扰。
+
+容量在构造时定死（向上取 2 的幂）；满了 tryPush 返回 false，空了 tryPop 返回 false，从不阻塞。
+需要阻塞语义的用 BoundedQueue（core/BoundedQueue.h）。*/
+template<typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity = 1024) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_  = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcRing() {
+        T tmp;
+        while (tryPop(tmp)) {}
+    }
+
+    MpmcRing(const MpmcRing&)            = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // 粗略的元素个数（并发下只是个估计）
+    size_t sizeApprox() const {
+        size_t tail = enqueuePos_.load(std::memory_order_relaxed);
+        size_t head = dequeuePos_.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+    // 满了返回 false（value 不会被移走）
+    template<class U>
+    bool tryPush(U&& value) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ::new (static_cast<void*>(cell.bytes)) T(std::forward<U>(value));
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // 这一圈的槽位还没被消费者读走：满了
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 空了返回 false
+    bool tryPop(T& out) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = cell.get();
+                    out = std::move(*p);
+                    p->~T();
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // 生产者还没写到这里：空了
+            } else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char bytes[sizeof(T)];
+
+        T* get() { return std::launder(reinterpret_cast<T*>(bytes)); }
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_{0};
+    // 两个游标分开放在不同的缓存行，生产者和消费者不互相踩
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
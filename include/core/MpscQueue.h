@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+/*多生产者单消费者无锁队列（Vyukov MPSC，链表 + 哨兵节点）
+
+生产者：一次 exchange 抢到尾部，再把前一个节点的 next 接上，不会互相阻塞；
+消费者：只有一个线程（reactor 的 loop 线程），顺着 next 往下取，不需要 CAS。
+
+注意：生产者 exchange 完、还没接上 next 的那一小段时间里，
+消费者会以为队列“暂时空了”，所以上层不能只靠 pop 返回 false 判断“真的没任务了”，
+reactor 里另外用一个计数来兜底。*/
+template<typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        T tmp;
+        while (pop(tmp)) {}
+        delete tail_;
+    }
+
+    MpscQueue(const MpscQueue&)            = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // 任意线程调用
+    template<class U>
+    void push(U&& value) {
+        Node* node = new Node(std::forward<U>(value));
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 只能由唯一的消费者线程调用；取不到返回 false
+    bool pop(T& out) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) return false;
+
+        out   = std::move(next->value);
+        tail_ = next;     // next 变成新的哨兵
+        delete tail;
+        return true;
+    }
+
+private:
+    struct Node {
+        Node() = default;
+        template<class U>
+        explicit Node(U&& v) : value(std::forward<U>(v)) {}
+
+        std::atomic<Node*> next{nullptr};
+        T value{};
+    };
+
+    std::atomic<Node*> head_;   // 生产者往这里挂
+    Node*              tail_;   // 消费者从这里取（哨兵）
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <memory>
+#include <functional>
+#include <sys/types.h>
+
+// 不可变的共享数据块：广播时一条消息只序列化一次，所有目标连接的输出队列都引用同一块
+using Slice = std::shared_ptr<const std::string>;
+
+/*连接的输出队列
+
+每条回包作为一个独立的块排队，不再像 std::string outbuf 那样 append 拼接、
+写一点就 erase(0, n) 整体搬移；
+队列里存的是 Slice（shared_ptr<const string>）的引用，入队不拷贝正文，
+同一条广播在 N 个连接的队列里只占一份内存；
+writeFd 用 writev 把队头若干块一次写出去（scatter output），
+部分写只移动块内偏移，写完的块直接出队。
+
+水位线：排队字节数涨到高水位时回调一次，之后降到低水位以下再回调一次（两次之间不会重复触发），
+上层（Server）据此暂停给这个连接推广播、必要时断开跟不上的慢客户端。回调在 loop 线程里执行。*/
+class OutputQueue
+{
+public:
+    // 一次 writev 最多带多少块（Linux IOV_MAX 是 1024，没必要那么多）
+    static constexpr int kMaxIov = 64;
+
+    // 参数是触发时排队的字节数
+    using WaterMarkCallback = std::function<void(size_t bytes)>;
+
+    // high 为 0 表示不检查
+    void setWaterMarks(size_t high, size_t low, WaterMarkCallback onHigh, WaterMarkCallback onLow) {
+        highMark_ = high;
+        lowMark_  = low < high ? low : high / 2;
+        onHigh_   = std::move(onHigh);
+        onLow_    = std::move(onLow);
+    }
+    // 是否处在“过了高水位、还没降回低水位”的状态
+    bool aboveHighWater() const { return aboveHigh_; }
+
+    bool   empty() const { return bytes_ == 0; }
+    // 还没写出去的总字节数
+    size_t bytes() const { return bytes_; }
+
+    // skip：这一块开头已经被直接 write 出去的字节数
+    void append(Slice data, size_t skip = 0) {
+        if (!data || skip >= data->size()) return;
+        bytes_ += data->size() - skip;
+        chunks_.push_back(Chunk{std::move(data), skip});
+        if (!aboveHigh_ && highMark_ > 0 && bytes_ >= highMark_) {
+            aboveHigh_ = true;
+            if (onHigh_) onHigh_(bytes_);
+        }
+    }
+
+    // 连接关闭时丢掉所有数据，不触发回调
+    void clear() {
+        chunks_.clear();
+        bytes_ = 0;
+        aboveHigh_ = false;
+    }
+
+    // writev 一次，返回写出的字节数；出错时 errno 写到 *savedErrno
+    ssize_t writeFd(int fd, int* savedErrno);
+
+private:
+    // 已经写出去 n 字节：整块写完的出队，写了一半的记在块的 offset 里
+    void consume(size_t n);
+
+private:
+    struct Chunk {
+        Slice  data;
+        size_t offset{0};   // 这一块已经写出去的字节数
+    };
+    std::deque<Chunk> chunks_;
+    size_t bytes_{0};
+
+    size_t highMark_{0};
+    size_t lowMark_{0};
+    bool   aboveHigh_{false};
+    WaterMarkCallback onHigh_;
+    WaterMarkCallback onLow_;
+};
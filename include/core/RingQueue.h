@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+/*环形数组队列（先进先出，不是线程安全的，由调用方加锁）
+
+std::deque / std::queue 每满一块就要分配新节点，空了又还回去；
+这里用一块 2 的幂大小的连续数组循环使用，满了才翻倍扩容，出队后槽位原地复用，
+容量只增不减，跑到稳定状态后入队出队都不再分配内存。
+
+元素只要求可移动（Task 这种只能移动的类型也可以放）。*/
+template<typename T>
+class RingQueue {
+public:
+    explicit RingQueue(size_t initialCapacity = 64) {
+        size_t cap = 1;
+        while (cap < initialCapacity) cap <<= 1;
+        allocate(cap);
+    }
+
+    ~RingQueue() { clear(); }
+
+    RingQueue(const RingQueue&)            = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    bool   empty()    const { return head_ == tail_; }
+    size_t size()     const { return tail_ - head_; }
+    size_t capacity() const { return mask_ + 1; }
+
+    template<class U>
+    void push(U&& value) {
+        if (size() == capacity()) grow();
+        ::new (slot(tail_)) T(std::forward<U>(value));
+        ++tail_;
+    }
+
+    // 空了返回 false
+    bool pop(T& out) {
+        if (empty()) return false;
+        T* p = slot(head_);
+        out = std::move(*p);
+        p->~T();
+        ++head_;
+        return true;
+    }
+
+    void clear() {
+        while (!empty()) {
+            slot(head_)->~T();
+            ++head_;
+        }
+    }
+
+private:
+    // 未初始化的原始存储，元素用 placement new 构造
+    struct Storage {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    T* slot(size_t i) { return std::launder(reinterpret_cast<T*>(&slots_[i & mask_])); }
+
+    void allocate(size_t cap) {
+        slots_.reset(new Storage[cap]);
+        mask_ = cap - 1;
+        head_ = tail_ = 0;
+    }
+
+    void grow() {
+        std::unique_ptr<Storage[]> old = std::move(slots_);
+        size_t oldMask = mask_;
+        size_t n = size();
+        size_t oldHead = head_;
+        allocate((oldMask + 1) * 2);
+        for (size_t i = 0; i < n; ++i) {
+            T* p = std::launder(reinterpret_cast<T*>(&old[(oldHead + i) & oldMask]));
+            ::new (slot(i)) T(std::move(*p));
+            p->~T();
+        }
+        tail_ = n;
+    }
+
+    std::unique_ptr<Storage[]> slots_;
+    size_t mask_{0};
+    size_t head_{0};   // 单调递增，取下标时 & mask_
+    size_t tail_{0};
+};
@@ -4,18 +4,54 @@
 #include "chat/MessageHandler.h"
 #include <unordered_map>
 #include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+using ConnectionPtr = utils::ConnectionPtr;
 
 
 class Server
 {
-private:
-/*onEvent 的功能就是：
-
-判断这个事件是不是 listenfd
-
-如果是 listenfd 且可读 → 说明有客户端连接 → 交给 onAccept()
+public:
+    // 一个连接的 outbuf 积压（巡检时的快照，给监控看谁落后了）
+    struct ConnBacklog {
+        int      fd;
+        uint64_t connId;
+        int      userId;        // 还没登录是 0
+        size_t   queuedBytes;
+        bool     slow;          // 过了高水位，正停推广播
+    };
 
-如果是普通 fd → 按 events 类型分别进入：
+private:
+    /*一个 IO 线程（one loop per thread）
+    主 reactor 只负责 accept，新连接按 fd 分给某个 IoLoop，
+    之后这个连接的读、写、EPOLLOUT 切换、关闭都只在这个 IoLoop 里发生。
+    conns 也按 loop 拆开，并且只在这个 loop 的线程里访问，
+    其它线程（acceptor、业务线程）想动连接都通过 rt->runInLoop 投递任务，所以不需要锁。*/
+    struct IoLoop {
+        std::unique_ptr<reactor> owned;   // 子 reactor（单 reactor 模式下为空）
+        reactor* rt{nullptr};             // 实际使用的 reactor
+        std::thread th;                   // 跑 rt->loop() 的线程（单 reactor 模式下不创建）
+        std::unordered_map<int, ConnectionPtr> conns;   // 只在 loop 线程访问
+        std::atomic<size_t> queuedBytes{0};   // 最近一次巡检时所有连接 outbuf 积压的字节数（给 stats 读）
+        // 最近一次巡检时有积压的连接；loop 线程每次巡检整份换掉，stats() 在别的线程拷贝，用锁护着
+        std::mutex backlogMtx;
+        std::vector<ConnBacklog> backlog;
+
+        // 优雅关闭：draining 之后不再读新请求，连接回完在途请求、写完 outbuf 就关
+        bool draining{false};                 // 只在 loop 线程访问
+        reactor::TimerId drainTimer{0};
+        std::atomic<bool> drained{false};     // conns 已经清空（主线程等它）
+    };
+
+/*onListenerEvent：主 reactor 上的 listenfd 可读 → 说明有客户端连接 → 交给 onAccept()；
+热重启的控制 socket 可读 → 交给 onHandoffRequest()
+
+onEvent 处理普通 fd → 按 events 类型分别进入：
 
 EPOLLIN → onConnRead()
 
@@ -24,11 +60,47 @@ EPOLLOUT → onConnWrite()
 EPOLLERR / EPOLLHUP → closeConn()
 
 它是事件类型 → 函数选择器。*/
-    void onEvent(int fd, uint32_t events, void* user);
+    void onListenerEvent(int fd, uint32_t events);
+    void onEvent(IoLoop& loop, int fd, uint32_t events, void* user);
     //处理新连接到来的事件，并把连接纳入 Server 管理。
     void onAccept();
+    //在连接所属的 loop 线程里登记连接并注册到它的 reactor
+    void registerConn(IoLoop& loop, const ConnectionPtr& conn);
     //从客户端读取数据、解析数据、交给业务层处理。
-    void onConnRead(Connection& conn);
+    void onConnRead(IoLoop& loop, const ConnectionPtr& conn);
+    //把 inbuf 里已经收全的请求拆出来逐条投递；连接被暂停读时停在当前位置
+    void processInput(IoLoop& loop, const ConnectionPtr& conn);
+    //把拆出来的一条请求（文本行 / 二进制帧）投递给线程池（不阻塞，过载时直接回 server busy）
+    void dispatchRequest(IoLoop& loop, const ConnectionPtr& conn, uint8_t op, std::string body);
+    //业务线程处理完一条请求（回包已经投递给 loop）：扣全服在途数，连接的在途数排在回包后面由 loop 扣，降到低水位时恢复读
+    void finishRequest(IoLoop& loop, const ConnectionPtr& conn);
+    //过载时回一条 server busy：连接没有在途请求就在 loop 线程里直接回，有的话排在它们的回包后面
+    void rejectBusy(IoLoop& loop, const ConnectionPtr& conn, uint8_t op);
+    //在途请求太多：摘掉 EPOLLIN，让 TCP 接收窗口把压力传回客户端
+    void pauseReading(IoLoop& loop, Connection& conn);
+    void resumeReading(IoLoop& loop, const ConnectionPtr& conn);
+    //按 readPaused / wantWrite 重新计算要监听的事件
+    void updateEvents(IoLoop& loop, Connection& conn);
+    //空闲超时：定时器只按“最后活跃时间 + 超时”懒惰地检查，读数据时只更新时间戳，不动定时器
+    void armIdleTimer(IoLoop& loop, const ConnectionPtr& conn, int64_t delayMs);
+    void onIdleTimer(IoLoop& loop, const std::weak_ptr<Connection>& weakConn);
+    //心跳快路径：在 loop 线程里直接回 pong；连接还有在途请求时返回 false，交给 strand 按顺序回
+    bool replyPong(IoLoop& loop, Connection& conn, uint8_t op);
+    //粗粒度扫描：关掉心跳超时的连接（顺带把它们从房间里摘掉）
+    void sweepDeadSessions(IoLoop& loop);
+    //outbuf 水位回调：过高水位标记成慢消费者（停推广播），降回低水位恢复
+    void onOutputHighWater(Connection& conn, size_t bytes);
+    void onOutputLowWater(Connection& conn, size_t bytes);
+    //定期统计各连接 outbuf 的积压，把落后最多的几个打到日志里
+    void reportOutputBacklog(IoLoop& loop);
+    //停止 accept：关掉监听 fd 和热重启的控制 socket（只在主 reactor 线程调用）
+    void stopAccepting();
+    //新进程来要监听 fd：交出去之后停止 accept，让主 loop 返回，由 main 接着 drain
+    void onHandoffRequest();
+    //优雅关闭：在每个 loop 里通知客户端、停止读，之后定期关掉已经排空的连接
+    void beginDrain(IoLoop& loop);
+    void drainConn(IoLoop& loop, const ConnectionPtr& conn);
+    void checkDrained(IoLoop& loop);
     //把 outbuf 里的数据在循环内尽量 write 完
     void onConnWrite(Connection& conn);
     void closeConn(int fd);
@@ -53,33 +125,110 @@ EPOLLERR / EPOLLHUP → closeConn()
     //这个函数的逻辑移动到了Messagehandler
     // std::string processLine(Connection& c, const std::string& line);
 
-    //这是业务线程安全投递“要写的数据”的入口，用状态机和 EPOLLOUT 驱动真正的写回
-    void postWrite(int fd, std::string data);
+    //这是业务线程安全投递“要写的数据”的入口：打包成任务交给连接所属的 loop，
+    //closeAfter = true 表示写完就关（quit）
+    void postWrite(IoLoop& loop, const ConnectionPtr& conn, std::string data,
+                   bool closeAfter = false);
+    //在 loop 线程里追加 outbuf，用状态机和 EPOLLOUT 驱动真正的写回
+    void sendInLoop(IoLoop& loop, Connection& conn, const Slice& data,
+                    bool closeAfter);
 
     //tool
     bool setNonBlock(int fd);
     bool setTcpNoDelay(int fd);
+    //fd 固定映射到一个 loop：同一时刻一个 fd 只属于一个连接，所以不需要额外的 fd -> loop 表
+    IoLoop& loopOf(int fd) { return *loops_[static_cast<size_t>(fd) % loops_.size()]; }
+
+    // 新增：按房间广播（text / binary 是同一条消息在两种协议下的编码）
+    void broadcastToRoom(int roomId, std::string text, std::string binary);
 
-    // 新增：按房间广播
-    void broadcastToRoom(int roomId, const std::string& data);
+public:
+    // 过载保护的阈值
+    static constexpr int kMaxConnInflight    = 64;   // 单个连接在途请求到这个数就暂停读
+    static constexpr int kResumeConnInflight = 16;   // 降到这个数恢复读
+    // outbuf 积压巡检的周期和每次最多打印几个连接
+    static constexpr int64_t kBacklogReportMs  = 10 * 1000;
+    static constexpr size_t  kBacklogReportTop = 5;
+    // 优雅关闭时多久检查一次连接排空没有
+    static constexpr int64_t kDrainCheckMs = 50;
+
+    // 过载相关的计数（都是近似值，给监控 / 日志用）
+    struct Stats {
+        size_t   inflight;      // 全服在途请求数（排队 + 正在处理）
+        size_t   poolQueued;    // 线程池里排队的任务数
+        uint64_t rejected;      // 因为过载回了 server busy 的请求数
+        uint64_t readPauses;    // 暂停读连接的次数
+        uint64_t pings;         // 收到的心跳数
+        uint64_t deadSessions;  // 因为心跳超时被关掉的连接数
+        size_t   slowConsumers;      // 当前 outbuf 积压过了高水位的连接数
+        uint64_t droppedBroadcasts;  // 因为对方是慢消费者而没发的广播条数
+        uint64_t evictedSlow;        // 积压超过硬上限被断开的连接数
+        size_t   outputBytes;        // 最近一次巡检时全服 outbuf 积压的字节数
+        std::vector<ConnBacklog> backlog;   // 最近一次巡检时 outbuf 有积压的连接，积压多的在前
+    };
+    Stats stats() const;
 
 private:
     reactor& reactor_;
     ThreadPool* Threadpool_;
     int listenFd_{-1};
+    std::string handoffPath_;   // 热重启控制 socket 的路径，空表示不支持
+    int controlFd_{-1};
+    bool handedOff_{false};     // 监听 fd 已经交给新进程了
     uint16_t port_{0};
     bool useET_{true};
-
-    std::unordered_map<int, std::unique_ptr<Connection>> conns_;
-    std::mutex conns_mtx_; // 保护 conns_ 以及 Connection.outbuf 等跨线程访问
+    int ioThreads_{0};   // 子 reactor 数量，0 表示只用主 reactor
+    uint64_t nextConnId_{1};   // 连接编号，只在 accept 线程里递增
+
+    // 过载保护：全服在途请求超过 busyHighWater_ 时新请求直接回 server busy
+    size_t busyHighWater_{768};
+    int64_t idleTimeoutMs_{300 * 1000};   // 连接多久没发数据就关掉，<= 0 不检查
+    int64_t heartbeatTimeoutMs_{90 * 1000};   // 发过心跳的连接多久没动静算死掉，<= 0 不检查
+    std::atomic<uint64_t> pings_{0};
+    std::atomic<uint64_t> deadSessions_{0};
+    std::atomic<size_t>   inflight_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> readPauses_{0};
+
+    // 慢消费者：outbuf 积压到高水位停推广播，降到低水位恢复，超过硬上限直接断开
+    size_t outputHighWater_{1024 * 1024};
+    size_t outputLowWater_{256 * 1024};
+    size_t maxOutputBytes_{8 * 1024 * 1024};
+    std::atomic<size_t>   slowConsumers_{0};
+    std::atomic<uint64_t> droppedBroadcasts_{0};
+    std::atomic<uint64_t> evictedSlow_{0};
+
+    std::vector<std::unique_ptr<IoLoop>> loops_;
     std::atomic<bool> running_{false};
     MessageHandler msgHandler_;   //  新增：业务处理器
 
 public:
-    Server(reactor& rect, uint16_t port, bool useET = true, ThreadPool* pool = nullptr);
+    // ioThreads：子 reactor 个数，-1 表示取 CPU 核数，0 表示退化成单 reactor（主 reactor 干所有事）
+    Server(reactor& rect, uint16_t port, bool useET = true, ThreadPool* pool = nullptr,
+           int ioThreads = -1);
     ~Server();
 
+    // 空闲超时（秒），在 start() 之前设置；<= 0 表示不检查
+    void setIdleTimeout(int seconds) { idleTimeoutMs_ = static_cast<int64_t>(seconds) * 1000; }
+    // 心跳超时（秒），在 start() 之前设置；客户端一般每 30 秒 ping 一次，默认允许丢两次
+    void setHeartbeatTimeout(int seconds) { heartbeatTimeoutMs_ = static_cast<int64_t>(seconds) * 1000; }
+    // 单个连接 outbuf 的水位（字节），在 start() 之前设置；maxBytes 为 0 表示积压多少都不断开
+    void setOutputLimits(size_t highWater, size_t lowWater, size_t maxBytes) {
+        outputHighWater_ = highWater;
+        outputLowWater_  = lowWater;
+        maxOutputBytes_  = maxBytes;
+    }
+
+    // 热重启控制 socket 的路径，在 start() 之前设置：
+    // start() 时先找这个路径上的旧进程要监听 fd，然后自己也在这里等下一个版本来要
+    void setHandoffPath(std::string path) { handoffPath_ = std::move(path); }
+    // 监听 fd 是不是已经交给新进程了（之后主 loop 会返回，调用方应当 drain）
+    bool handedOff() const { return handedOff_; }
+
     bool start();   // 创建监听并注册到 Reactor
+    // 优雅关闭：停止 accept，通知所有客户端，等在途请求回完、outbuf 写完（最多 timeoutMs），
+    // 然后 stop() 强制关掉剩下的。在主 reactor 的 loop() 返回之后、由同一个线程调用
+    void drain(int64_t timeoutMs);
     void stop();  // 停止监听并关闭所有连接
 };
 
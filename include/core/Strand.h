@@ -0,0 +1,43 @@
+#pragma once
+#include "Task.h"
+#include "RingQueue.h"
+#include <memory>
+#include <mutex>
+
+class ThreadPool;
+
+/*串行执行器（strand）：挂在线程池上，保证投递给它的任务按投递顺序、同一时刻最多一个 worker 在跑
+
+- 每个连接一个 strand：同一个连接的请求按到达顺序处理，回包也按这个顺序投递到 loop，
+  业务代码改 Connection 上的会话状态（authed / name / roomId）不需要加锁；
+- 不同连接的 strand 互不影响，仍然在多个 worker 上并行；
+- 不占线程：有任务时才往线程池投一个“排空”任务，排空任务一次最多跑 kMaxBatch 个，
+  跑不完就把自己重新投递一次，免得一个很忙的连接一直霸占某个 worker；
+- 待执行的任务按值放在环形数组里，锁只保护入队出队这几条指令（同一连接基本没有竞争），
+  投递一个任务不分配内存。
+
+post / tryPost 可以在任意线程调用。*/
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+    explicit Strand(ThreadPool& pool) : pool_(pool) {}
+
+    Strand(const Strand&)            = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    void post(Task task);
+    // 不阻塞的 post：需要启动排空而线程池全局队列已满时返回 false，task 原样留给调用方
+    bool tryPost(Task& task);
+
+private:
+    static constexpr int kMaxBatch = 64;
+
+    void drain();
+
+    ThreadPool& pool_;
+    std::mutex      mtx_;
+    RingQueue<Task> queue_{8};
+    // 是否已经有 drain 在线程池里（排队或正在跑）；由 false 变 true 的那个 post 负责投递
+    bool            running_{false};
+};
+
+using StrandPtr = std::shared_ptr<Strand>;
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*只能移动的任务对象，用来代替线程池里的 std::function<void()>
+
+std::function 要求可拷贝，而且捕获稍微大一点（libstdc++ 超过 16 字节）就要堆分配；
+业务请求的 lambda 一般捕获 this + 连接的 shared_ptr + 一整行 std::string，每次投递都要 new 一次。
+Task 自带 kInlineSize 字节的内联缓冲区，装得下的可调用对象直接原地构造，不分配内存；
+装不下（或者移动构造可能抛异常）的才退回堆上。
+
+只支持 void() 调用；可以从任意可调用对象（包括 std::function）隐式构造。*/
+class Task {
+public:
+    static constexpr size_t kInlineSize = 96;
+
+    Task() noexcept = default;
+
+    template<class F,
+             class D = std::decay_t<F>,
+             class = std::enable_if_t<!std::is_same_v<D, Task> && std::is_invocable_r_v<void, D&>>>
+    Task(F&& f) {
+        if constexpr (fitsInline<D>()) {
+            ::new (static_cast<void*>(buf_)) D(std::forward<F>(f));
+            ops_ = &InlineOps<D>::table;
+        } else {
+            *reinterpret_cast<D**>(buf_) = new D(std::forward<F>(f));
+            ops_ = &HeapOps<D>::table;
+        }
+    }
+
+    Task(Task&& other) noexcept { moveFrom(other); }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&)            = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    void operator()() { ops_->invoke(buf_); }
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(buf_);
+            ops_ = nullptr;
+        }
+    }
+
+    // 可调用对象类型 F 能不能直接放进内联缓冲区（给基准测试和静态断言用）
+    template<class F>
+    static constexpr bool fitsInline() {
+        return sizeof(F) <= kInlineSize
+            && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<F>;
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* buf);
+        // 把 src 里的对象移动到 dst，并销毁 src 里的
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void* buf) noexcept;
+    };
+
+    template<class F>
+    struct InlineOps {
+        static F* get(void* buf) { return std::launder(reinterpret_cast<F*>(buf)); }
+        static void invoke(void* buf) { (*get(buf))(); }
+        static void relocate(void* dst, void* src) noexcept {
+            ::new (dst) F(std::move(*get(src)));
+            get(src)->~F();
+        }
+        static void destroy(void* buf) noexcept { get(buf)->~F(); }
+        static constexpr Ops table{&invoke, &relocate, &destroy};
+    };
+
+    // 堆上的只在缓冲区里存一个指针，移动时搬指针就行
+    template<class F>
+    struct HeapOps {
+        static F*& get(void* buf) { return *reinterpret_cast<F**>(buf); }
+        static void invoke(void* buf) { (*get(buf))(); }
+        static void relocate(void* dst, void* src) noexcept {
+            *reinterpret_cast<F**>(dst) = get(src);
+        }
+        static void destroy(void* buf) noexcept { delete get(buf); }
+        static constexpr Ops table{&invoke, &relocate, &destroy};
+    };
+
+    void moveFrom(Task& other) noexcept {
+        if (other.ops_) {
+            other.ops_->relocate(buf_, other.buf_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char buf_[kInlineSize];
+    const Ops* ops_{nullptr};
+};
@@ -1,22 +1,64 @@
 #pragma once
-#include "SafeQueue.h"
+#include "WorkStealingDeque.h"
+#include "EventCount.h"
+#include "Task.h"
+#include "BoundedQueue.h"
 #include <thread>
 #include <atomic>
-#include <functional>
 #include <vector>
+#include <memory>
 
+/*工作窃取线程池
+
+- 每个 worker 有自己的 Chase-Lev 双端队列：worker 在任务里再提交的任务（比如 CacheClient 的后台刷新）
+  直接压进自己的队列，不碰任何锁；
+- 外部线程（reactor 等）提交的任务进全局注入队列（有界无锁 MPMC 环，BoundedQueue）；
+  worker 一次从里面拿一小批搬进自己的队列；
+- 自己的队列空了、全局队列也空了，就从随机一个别的 worker 那里偷（从队头偷，和 owner 不抢同一端）；
+- 实在没活就在 EventCount（futex）上睡，提交任务时只有真的有人在睡才会发起唤醒系统调用；
+- 任务是只能移动的 Task（内联缓冲区，常见的请求 lambda 不用堆分配），全局队列按值存放，
+  worker 队列里的任务节点从线程本地的空闲链表里复用，稳定运行时投递一个任务不分配内存。
+
+Enqueue 接受任意 void() 可调用对象（lambda、std::function 都行），全局队列满（maxCount）时阻塞等待；
+loop 线程里不能阻塞，要用 TryEnqueue，满了由调用方决定怎么降级。*/
 class ThreadPool {
 public:
     ThreadPool(size_t threadCount = 4, int maxCount = 1024);
     ~ThreadPool();
-    void Enqueue(std::function<void()> task);
+    void Enqueue(Task task);
+    // 不阻塞的提交（给 reactor 线程用）：全局队列满了返回 false，task 原样留给调用方
+    bool TryEnqueue(Task& task);
     void run();
 
+    // 排队等待执行的任务数（全局队列 + 各 worker 队列，并发下只是估计）
+    size_t pendingTasks() const;
+    // 全局队列容量
+    size_t capacity() const { return inject_.capacity(); }
+
 private:
-    std::atomic<bool> stop_;
-    std::vector<std::thread> workers_;
-    SafeQueue<std::function<void()>> tasks_;
+    struct Worker {
+        WorkStealingDeque<Task*> deque;
+        std::thread th;
+    };
+
+    void RunPool(size_t index);
+    // 依次尝试：自己的队列 -> 全局队列（顺便搬一批）-> 偷别人的
+    Task* findTask(size_t index);
+    Task* popGlobalBatch(size_t index);
+    // 任务节点（worker 队列里存的是指针）：优先从当前线程的空闲链表里拿
+    static Task* acquireNode(Task&& task);
+    static void  releaseNode(Task* node);
+    Task* stealFromOthers(size_t index);
+    bool  hasPendingWork() const;
+    void  runTask(Task* task);
 
 private:
-    void RunPool();
+    std::atomic<bool> stop_;
+    size_t threadCount_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // 全局注入队列（外部线程提交用）：满了 Enqueue 阻塞，生产者只在满的时候才会睡
+    BoundedQueue<Task> inject_;
+
+    EventCount idle_;   // 没活干的 worker 睡在这里
 };
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+
+/*分层时间轮（只在所属 reactor 的 loop 线程里用，不加锁）
+
+- 4 层，每层 64 个槽；第 0 层一个槽是一个 tick（默认 10ms），
+  第 k 层一个槽是 64^k 个 tick，总共能直接覆盖 64^4 个 tick（10ms 时约 1.9 天），
+  再远的先挂在最高层，转下来时重新计算位置；
+- 每个槽是一个侵入式双向链表：插入、取消都是 O(1)，不用像最小堆那样 O(log n)；
+- 每转过第 0 层一圈，把上一层对应槽里的定时器“降级”重新分配一次（cascade），
+  每个定时器一生最多被搬 3 次；
+- 定时器编号由调用方（reactor）分配，这里用一张 编号 -> 节点 的表支持按编号取消。
+
+回调在 advance() 里执行，回调内部可以再 add / cancel（包括取消自己这个周期定时器，
+以及取消同一个 tick 里还没轮到的定时器：它们已经摘下来了，cancel 只打标记，轮到时跳过并释放）。*/
+class TimerWheel {
+public:
+    using TimerId  = uint64_t;
+    using Callback = std::function<void()>;
+
+    explicit TimerWheel(int64_t tickMs = 10);
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&)            = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    // nowMs 之后 delayMs 到期；intervalMs > 0 表示之后每隔 intervalMs 再触发一次
+    void add(TimerId id, int64_t nowMs, int64_t delayMs, int64_t intervalMs, Callback cb);
+    // 已经触发过的一次性定时器、不存在的编号返回 false
+    bool cancel(TimerId id);
+    // 推进到 nowMs，执行所有到期的定时器
+    void advance(int64_t nowMs);
+    // 距离下一次需要 advance 还有多少毫秒；没有定时器返回 -1（给 epoll_wait 当超时用）
+    int nextTimeoutMs(int64_t nowMs) const;
+
+    size_t size() const { return timers_.size(); }
+
+private:
+    static constexpr int      kLevels   = 4;
+    static constexpr int      kSlotBits = 6;
+    static constexpr uint64_t kSlots    = 1u << kSlotBits;
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+
+    struct Node {
+        TimerId  id{0};
+        uint64_t expireTick{0};
+        int64_t  intervalMs{0};
+        Callback cb;
+        Node*    prev{nullptr};
+        Node*    next{nullptr};
+        bool     detached{false};    // 在正在到期的这一批里（已经从槽里摘下，可能回调正在执行）
+        bool     cancelled{false};   // 摘下之后被取消（同一批前面的回调 / 自己的回调里 cancel）
+    };
+
+    // 槽是带哨兵的环形链表，空槽的哨兵指向自己
+    struct Slot {
+        Node head;
+        Slot() { head.prev = head.next = &head; }
+        bool empty() const { return head.next == &head; }
+    };
+
+    uint64_t tickOf(int64_t ms) const;
+    void place(Node* node);
+    static void unlink(Node* node);
+    void cascade(int level);
+    void expireCurrent();
+
+    int64_t  tickMs_;
+    int64_t  startMs_{-1};     // 第 0 个 tick 对应的时间，第一次 add / advance 时确定
+    uint64_t currentTick_{0};
+    Slot     wheel_[kLevels][kSlots];
+    std::unordered_map<TimerId, Node*> timers_;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*Chase-Lev 工作窃取双端队列（按 Lê 等人 2013 年的 C11 内存模型版本实现）
+
+- 只有拥有它的那个 worker 线程能 push / pop（从底部，后进先出，缓存更热）；
+- 其它 worker 可以同时 steal（从顶部，先进先出），靠对 top_ 的 CAS 互相排斥；
+- 元素是指针，队列本身不管它指向的对象的生命周期；
+- 环形数组满了由 owner 扩容成两倍；旧数组可能还有小偷在读，先放进 retired_ 里，
+  等整个队列析构时一起释放（每次翻倍，总共多占不到一倍内存）。*/
+template<typename T>
+class WorkStealingDeque {
+    static_assert(std::is_pointer<T>::value, "WorkStealingDeque stores pointers");
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0)
+    {
+        auto a = std::make_unique<Array>(capacity);
+        array_.store(a.get(), std::memory_order_relaxed);
+        retired_.push_back(std::move(a));
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&)            = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // 只能由 owner 调用
+    void push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array*  a = array_.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1) a = grow(a, b, t);
+        a->put(b, item);
+        // release：小偷 acquire 读到新的 bottom_ 时一定也能看到刚放进去的元素
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    // 只能由 owner 调用；空了返回 nullptr
+    T pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array*  a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            // 本来就是空的
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = a->get(b);
+        if (t == b) {
+            // 只剩最后一个，和小偷抢
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                              std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // 任意线程调用；空了或者和别人抢输了返回 nullptr
+    T steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) return nullptr;
+
+        Array* a = array_.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // 粗略的元素个数（并发下只是个估计）
+    int64_t sizeApprox() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+    bool emptyApprox() const { return sizeApprox() == 0; }
+
+private:
+    struct Array {
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), slots(new std::atomic<T>[cap]) {}
+
+        T get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T v) { slots[i & mask].store(v, std::memory_order_relaxed); }
+
+        int64_t capacity;   // 2 的幂
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+    };
+
+    Array* grow(Array* old, int64_t b, int64_t t) {
+        auto bigger = std::make_unique<Array>(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i) bigger->put(i, old->get(i));
+        Array* raw = bigger.get();
+        retired_.push_back(std::move(bigger));
+        array_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    alignas(64) std::atomic<int64_t> top_;      // 小偷从这里偷
+    alignas(64) std::atomic<int64_t> bottom_;   // owner 在这里进出
+    std::atomic<Array*> array_;
+    std::vector<std::unique_ptr<Array>> retired_;   // 只有 owner 扩容时改
+};
@@ -5,21 +5,48 @@
 #include <atomic>
 #include <functional>
 #include <unordered_map>
+#include <thread>
+#include "MpscQueue.h"
+#include "TimerWheel.h"
 class reactor
 {
 public:
 // 当 epoll_wait 检测到某个文件描述符（socket）发生了事件，
 // Reactor 就会调用你设置的 Dispatch Function（事件分发函数） 来处理它。
     using DispatchFunction = std::function<void(int fd, uint32_t events, void* user)>;
+    // 投递到 loop 线程执行的任务
+    using Functor = std::function<void()>;
 private:
     int epfd_{-1};
     int evfd_{-1};
     std::vector<epoll_event> eventList_;
     std::atomic<bool> running_{false};
+    // stop() 可能早于 loop() 被调用（子 reactor 线程还没跑起来），用 quit_ 记住“已经要求退出”
+    std::atomic<bool> quit_{false};
     bool useET;
     DispatchFunction dispatcher_;
     std::mutex user_mtx_;
     std::unordered_map<int, void*> users_;
+
+    // 跑 loop() 的线程，用来判断调用方是不是 loop 线程自己
+    std::atomic<std::thread::id> threadId_{};
+
+    // 其它线程投递过来、等待 loop 线程执行的任务：
+    // 新连接交接、业务线程的写回、打开 EPOLLOUT、关闭连接都走这里，
+    // 所以 epoll_ctl 和 Connection 的 IO 状态只会在 loop 线程里被碰到
+    MpscQueue<Functor> pendingFunctors_;
+    // 已投递但还没被执行的任务数；只有从 0 变 1 的那个投递者才去写 eventfd（唤醒合并）
+    std::atomic<int64_t> pendingCount_{0};
+
+    // 在 loop 线程里执行 pendingFunctors_
+    void doPendingFunctors();
+
+    // 定时器：时间轮只在 loop 线程里碰；编号在投递前就分配好，所以任意线程都能拿到返回值
+    TimerWheel timers_;
+    std::atomic<uint64_t> nextTimerId_{1};
+    // 这一轮 epoll_wait 返回的时间（毫秒，单调时钟），给上层当“现在”用，省得每次读 socket 都取一次时间
+    int64_t pollReturnMs_{0};
+    TimerWheel::TimerId addTimer(int64_t delayMs, int64_t intervalMs, Functor cb);
 public:
     explicit reactor(int MaxEvent, bool useET = true);
     ~reactor();
@@ -33,8 +60,12 @@ public:
 // Reactor 的主循环，程序会一直在里面等待 I/O 事件，并在事件发生时调用你的 DispatchFunction 处理它。
 // loop() 不结束 → 服务器就一直在线
 // loop() 结束 → 服务器停止运行
+// stop() 让 loop() 返回之后可以再调一次 loop() 接着跑（定时器、fd 都还在）
     void loop();
     void stop();
+// 信号处理函数里用的 stop()：只置 quit_、往 eventfd 写 8 字节，
+// 不打日志、不加锁、不分配内存（async-signal-safe）
+    void stopFromSignal();
 
 
 // wakeupFd() 只是“取出这个 eventfd 的文件描述符（FD）”。
@@ -66,5 +97,26 @@ public:
 
 // 这就是“唤醒 epoll”。
     void wakeup(); 
+
+// 把任务交给 loop 线程：放进 pendingFunctors_，必要时 wakeup() 让 epoll_wait 返回，
+// loop 在处理完这一批事件后统一执行。
+    void queueInLoop(Functor cb);
+// 当前就在 loop 线程里就直接执行，否则 queueInLoop
+    void runInLoop(Functor cb);
+    bool isInLoopThread() const {
+        return threadId_.load(std::memory_order_acquire) == std::this_thread::get_id();
+    }
+
+// 定时器（回调在 loop 线程里执行）；任意线程都可以调用。
+// 取消要和添加在同一个线程里调用（或者在 loop 线程里），否则取消可能先于添加到达而不生效。
+    using TimerId = TimerWheel::TimerId;
+    TimerId runAfter(int64_t delayMs, Functor cb);
+    TimerId runEvery(int64_t intervalMs, Functor cb);
+    void cancel(TimerId id);
+
+    // 单调时钟的当前毫秒数
+    static int64_t nowMs();
+    // 最近一次 epoll_wait 返回的时间，只在 loop 线程里用
+    int64_t pollReturnMs() const { return pollReturnMs_; }
 };
 
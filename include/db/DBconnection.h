@@ -1,12 +1,19 @@
 #pragma once
+#include "db/PreparedStatement.h"
 #include <mysql/mysql.h>
 #include <string>
 #include <memory>
+#include <unordered_map>
 
 class DBconnection
 {
 private:
     MYSQL* SqlConn_{nullptr};
+
+    // 这个连接上 prepare 过的语句，按 SQL 文本缓存（服务端的 stmt 是跟连接走的）
+    std::unordered_map<std::string, std::unique_ptr<PreparedStatement>> stmts_;
+    // 缓存的语句超过这么多就全部关掉重来（防止拼出来的 SQL 文本不收敛，把服务端 max_prepared_stmt_count 用光）
+    static constexpr size_t kMaxCachedStatements = 64;
 public:
     DBconnection(/* args */);
     ~DBconnection();
@@ -29,6 +36,13 @@ public:
     // 执行增删改
     bool update(const std::string& sql);
 
+    // 按连接的字符集转义字符串（拼进 SQL 的单引号里用），防止内容里的引号把 SQL 搞坏
+    std::string escape(const std::string& s);
+
+    // 取 sql 对应的预处理语句：第一次在这个连接上 prepare，之后直接复用（执行出错作废的会重新 prepare）。
+    // 失败返回 nullptr。语句归连接所有，连接还回池子之后别再用
+    PreparedStatement* prepare(const std::string& sql);
+
     MYSQL* raw() {return SqlConn_;}
 };
 
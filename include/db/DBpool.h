@@ -1,6 +1,7 @@
 #pragma once
 #include "DBconnection.h"
-#include "core/SafeQueue.h"
+#include "core/BoundedQueue.h"
+#include <mutex>
 
 
 class DBPool {
@@ -26,7 +27,7 @@ private:
     DBPool& operator=(const DBPool&) = delete;
 
 private:
-    SafeQueue<DBConnectionPtr> pool_;
+    BoundedQueue<DBConnectionPtr> pool_;   // 空闲连接（无锁有界队列，取连接带超时）
     std::once_flag initFlag_;
     bool inited_{false};
 
@@ -0,0 +1,87 @@
+#pragma once
+#include <mysql/mysql.h>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*服务端预处理语句（mysql_stmt_*）
+
+SQL 只在第一次用的时候发给服务端解析一次（prepare），之后每次只发参数值（二进制协议）：
+- 省掉每次的解析 / 生成执行计划；
+- 参数按类型绑定，不用拼字符串、不用转义，也就没有 SQL 注入；
+- 结果按列类型取回：整数列直接是 int64_t，不再 atoi / atoll 文本。
+
+由 DBconnection::prepare 按 SQL 文本缓存在连接上（一个连接同一时刻只在一个线程手里，不加锁）。
+用法：bindXxx 绑好每个 ? → execute → SELECT 的话循环 fetch + getXxx 取列。
+execute 失败后语句作废（连接断了 / 表结构变了），下次 DBconnection::prepare 会重新 prepare。*/
+class PreparedStatement {
+public:
+    PreparedStatement(MYSQL* conn, const std::string& sql);
+    ~PreparedStatement();
+
+    PreparedStatement(const PreparedStatement&)            = delete;
+    PreparedStatement& operator=(const PreparedStatement&) = delete;
+
+    // prepare 成功且没有因为执行出错作废
+    bool valid() const { return stmt_ != nullptr && !broken_; }
+    const std::string& sql() const { return sql_; }
+
+    // 按 ? 出现的顺序绑定参数（下标从 0 开始）；值会拷一份，调用方的字符串不用活到 execute
+    void bindInt(unsigned idx, int64_t value);
+    void bindString(unsigned idx, const std::string& value);
+    void bindNull(unsigned idx);
+
+    // 执行；SELECT 的结果整个取到客户端，之后用 fetch 逐行读
+    bool execute();
+    // 读下一行：有返回 true；读完了或者出错返回 false（用 ok() 区分）
+    bool fetch();
+    // 最近一次 execute / fetch 是否成功（fetch 读到头不算失败）
+    bool ok() const { return ok_; }
+
+    // 当前行第 col 列（下标从 0 开始）；NULL 读出来是 0 / 空串
+    bool        isNull(unsigned col) const;
+    int64_t     getInt(unsigned col) const;
+    std::string getString(unsigned col) const;
+
+    // INSERT / UPDATE / DELETE 影响的行数
+    uint64_t affectedRows() const;
+
+private:
+    // MySQL 8 里是 bool，老版本 / MariaDB 是 my_bool，跟着头文件走
+    using NullFlag  = std::remove_pointer_t<decltype(MYSQL_BIND::is_null)>;
+    using ErrorFlag = std::remove_pointer_t<decltype(MYSQL_BIND::error)>;
+
+    struct Param {
+        int64_t       i{0};
+        std::string   s;
+        unsigned long length{0};
+        NullFlag      isNull{0};
+    };
+    struct Column {
+        bool              isInt{false};
+        int64_t           i{0};
+        std::vector<char> buf;
+        unsigned long     length{0};
+        NullFlag          isNull{0};
+        ErrorFlag         error{0};
+    };
+
+    // 字符串列的初始缓冲区，放不下的那一行再按实际长度扩
+    static constexpr size_t kInitialColumnBuffer = 256;
+
+    void setupResult();
+    bool bindResult();
+    void fail(const char* what);
+
+    MYSQL_STMT* stmt_{nullptr};
+    std::string sql_;
+    bool broken_{false};
+    bool ok_{true};
+
+    std::vector<Param>      params_;
+    std::vector<MYSQL_BIND> paramBinds_;
+    std::vector<Column>     columns_;
+    std::vector<MYSQL_BIND> resultBinds_;
+    bool rebind_{false};   // 有字符串列的缓冲区扩过，下次 fetch 前要重新 bind_result
+};
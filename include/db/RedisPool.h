@@ -1,6 +1,6 @@
 #pragma once
 #include "db/RedisConnection.h"
-#include "core/SafeQueue.h"
+#include "core/BoundedQueue.h"
 #include <string>
 #include <mutex>
 
@@ -24,7 +24,7 @@ private:
     RedisPool& operator=(const RedisPool&) = delete;
 
 private:
-    SafeQueue<RedisConnPtr> pool_;
+    BoundedQueue<RedisConnPtr> pool_;   // 空闲连接（无锁有界队列，取连接带超时）
     std::once_flag initFlag_;
     bool inited_{false};
 
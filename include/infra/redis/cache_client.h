@@ -2,6 +2,7 @@
 
 #include <nlohmann/json.hpp>
 #include "infra/redis/redis_client.h"
+#include "utils/SingleFlight.h"
 #include <functional>
 #include <thread>
 #include <optional>
@@ -19,6 +20,9 @@ namespace infra::redis {
  * - 逻辑过期缓存
  * - 防缓存穿透（空值缓存）
  * - 防缓存击穿（逻辑过期 + 异步重建）
+ * 
+ * 所有“查 DB + 回写缓存”都按 key 做 single-flight：同一个 key 的并发未命中 / 重建只调用一次 loader，
+ * 其它调用者等它的结果，不同 key 之间并行。
  */
 using Json = nlohmann::json;
 
@@ -176,6 +180,19 @@ private:
     /// 空值标记，用于防止缓存穿透
     static constexpr const char* NULL_MARK = "_NULL_";
 
+    /// 正在进行的 DB 加载（key → 加载结果的 JSON，DB 无数据时为 nullopt）
+    utils::SingleFlight<std::string, std::optional<Json>> loadFlight_;
+
+    /**
+     * @brief 查 DB 并写入逻辑过期缓存（同一个 key 并发调用只执行一次 loader）
+     * 
+     * @return DB 中的数据；DB 无数据返回 std::nullopt（不写缓存）
+     */
+    template <typename T>
+    std::optional<T> rebuildLogicalExpire(const std::string& key,
+                                          Seconds logicalTtl,
+                                          OptionalLoader<T>& loader);
+
     /**
      * @brief 提交后台任务
      * 
@@ -254,19 +271,47 @@ std::optional<T> CacheClient::getWithPassThrough(
         }
     }
 
-    // 2. 缓存未命中 / JSON 异常 → 查 DB
-    auto dbRes = loader();
+    // 2. 缓存未命中 / JSON 异常 → 查 DB（同一个 key 的并发未命中只查一次）
+    std::optional<Json> loaded = loadFlight_.run(key, [&]() -> std::optional<Json> {
+        auto dbRes = loader();
+
+        // 2.1 DB 也没数据：写入空值标记 + 短 TTL 防穿透
+        if (!dbRes.has_value()) {
+            redis_.set(key, NULL_MARK, nullTtl);
+            return std::nullopt;
+        }
+
+        // 2.2 DB 有数据：写回缓存 + 正常 TTL
+        Json j = *dbRes;
+        redis_.set(key, j.dump(), normalTtl);
+        return j;
+    });
 
-    // 2.1 DB 也没数据：写入空值标记 + 短 TTL 防穿透
-    if (!dbRes.has_value()) {
-        redis_.set(key, NULL_MARK, nullTtl);
+    if (!loaded.has_value()) {
         return std::nullopt;
     }
+    return loaded->get<T>();
+}
+
+template <typename T>
+std::optional<T> CacheClient::rebuildLogicalExpire(const std::string& key,
+                                                   Seconds logicalTtl,
+                                                   OptionalLoader<T>& loader)
+{
+    std::optional<Json> loaded = loadFlight_.run(key, [&]() -> std::optional<Json> {
+        auto dbRes = loader();
+        if (!dbRes.has_value()) {
+            return std::nullopt;
+        }
+
+        setLogicalExpire<T>(key, *dbRes, logicalTtl);
+        return Json(*dbRes);
+    });
 
-    // 2.2 DB 有数据：写回缓存 + 正常 TTL
-    Json j = *dbRes;
-    redis_.set(key, j.dump(), normalTtl);
-    return dbRes;
+    if (!loaded.has_value()) {
+        return std::nullopt;
+    }
+    return loaded->get<T>();
 }
 
 template<typename T>
@@ -282,13 +327,7 @@ std::optional<T> CacheClient::getWithLogicalExpire(
 
     // 1.1 完全没命中 → 直接查 DB + 构建逻辑过期结构
     if (!cacheVal.has_value()) {
-        auto dbRes = loader();
-        if (!dbRes.has_value()) {
-            return std::nullopt;
-        }
-
-        setLogicalExpire<T>(key, *dbRes, logicalTtl);
-        return dbRes;
+        return rebuildLogicalExpire<T>(key, logicalTtl, loader);
     }
 
     // 2. 尝试解析 JSON
@@ -297,13 +336,7 @@ std::optional<T> CacheClient::getWithLogicalExpire(
         j = Json::parse(*cacheVal);
     } catch (const Json::parse_error&) {
         // Redis 里存的是垃圾 / 旧数据 → 查 DB + 重建
-        auto dbRes = loader();
-        if (!dbRes.has_value()) {
-            return std::nullopt;
-        }
-
-        setLogicalExpire<T>(key, *dbRes, logicalTtl);
-        return dbRes;
+        return rebuildLogicalExpire<T>(key, logicalTtl, loader);
     }
 
     // 3. 兼容旧格式：没有 data/expireAt，就当它是直接存了一个 T
@@ -312,13 +345,7 @@ std::optional<T> CacheClient::getWithLogicalExpire(
             return j.get<T>();
         } catch (const Json::type_error&) {
             // 旧数据也解析不了 → 当作坏数据 → 查 DB + 重建
-            auto dbRes = loader();
-            if (!dbRes.has_value()) {
-                return std::nullopt;
-            }
-
-            setLogicalExpire<T>(key, *dbRes, logicalTtl);
-            return dbRes;
+            return rebuildLogicalExpire<T>(key, logicalTtl, loader);
         }
     }
 
@@ -336,13 +363,7 @@ std::optional<T> CacheClient::getWithLogicalExpire(
         data = j["data"].get<T>();
     } catch (...) {
         // data 字段异常，同样查 DB + 重建
-        auto dbRes = loader();
-        if (!dbRes.has_value()) {
-            return std::nullopt;
-        }
-
-        setLogicalExpire<T>(key, *dbRes, logicalTtl);
-        return dbRes;
+        return rebuildLogicalExpire<T>(key, logicalTtl, loader);
     }
 
     auto nowSec = duration_cast<Seconds>(
@@ -355,14 +376,12 @@ std::optional<T> CacheClient::getWithLogicalExpire(
     }
 
     // 4.2 已过期 → 先返回旧 data，再异步重建缓存
+    //     同一时刻多个请求看到过期会各自提交重建，重叠的那些在 loadFlight_ 里合并成一次 loader
     submitBackground([this,
                       key,
                       logicalTtl,
                       loader = std::forward<OptionalLoader<T>>(loader)]() mutable {
-        auto fresh = loader();
-        if (fresh.has_value()) {
-            this->setLogicalExpire<T>(key, *fresh, logicalTtl);
-        }
+        this->rebuildLogicalExpire<T>(key, logicalTtl, loader);
     });
 
     // 对调用方来说：虽然逻辑已过期，但这里仍兜底返回旧 data
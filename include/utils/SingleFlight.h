@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace utils {
+
+/*按 key 合并并发加载（single-flight）：同一个 key 同一时刻只有一个调用者真正去加载，
+其它调用者拿同一个 shared_future 等它的结果；不同 key 之间互不等待。
+
+用来替代“缓存未命中时加一把全局锁再 double-check”的写法：
+- 同一个 key 的并发 miss 只打一次 DB（和全局锁一样防击穿）；
+- 不同 key 的 miss 并行加载（全局锁会把冷启动时成百上千个 key 排成一队）。
+
+加载完就从表里摘掉，结果不在这里缓存（缓存是调用方自己的事），
+之后再来的调用者会重新加载——所以 fn 里通常先再查一次缓存。
+fn 抛的异常会原样抛给所有等它的调用者。表按 key 的 hash 分片加锁，锁里只做查表 / 插入 / 删除。*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight {
+public:
+    SingleFlight() = default;
+    SingleFlight(const SingleFlight&)            = delete;
+    SingleFlight& operator=(const SingleFlight&) = delete;
+
+    // 执行 fn() 并返回它的结果；key 上已经有加载在跑就不执行，等那一次的结果。
+    // shared 不为空时告诉调用方这次结果是不是别人加载的
+    template <typename Fn>
+    Value run(const Key& key, Fn&& fn, bool* shared = nullptr) {
+        Shard& sh = shardOf(key);
+        std::promise<Value> promise;
+        {
+            std::unique_lock<std::mutex> lock(sh.mtx);
+            auto it = sh.inflight.find(key);
+            if (it != sh.inflight.end()) {
+                std::shared_future<Value> fut = it->second;
+                lock.unlock();
+                if (shared) *shared = true;
+                return fut.get();
+            }
+            sh.inflight.emplace(key, promise.get_future().share());
+        }
+        if (shared) *shared = false;
+
+        try {
+            Value value = fn();
+            finish(sh, key);
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            finish(sh, key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    // 当前正在加载的 key 数（监控用，不精确）
+    size_t inflight() {
+        size_t n = 0;
+        for (Shard& sh : shards_) {
+            std::lock_guard<std::mutex> lock(sh.mtx);
+            n += sh.inflight.size();
+        }
+        return n;
+    }
+
+private:
+    static constexpr size_t kShardCount = 16;
+    struct Shard {
+        std::mutex mtx;
+        std::unordered_map<Key, std::shared_future<Value>, Hash> inflight;
+    };
+    std::array<Shard, kShardCount> shards_;
+
+    Shard& shardOf(const Key& key) { return shards_[Hash{}(key) % kShardCount]; }
+
+    // 先摘掉再交结果：等待者手里有 future 的拷贝，摘掉不影响它们；之后来的调用者重新加载
+    void finish(Shard& sh, const Key& key) {
+        std::lock_guard<std::mutex> lock(sh.mtx);
+        sh.inflight.erase(key);
+    }
+};
+
+} // namespace utils
@@ -1,9 +1,22 @@
 #pragma once 
 #include <string>
 #include <atomic>
+#include <memory>
+#include <cstdint>
+#include "core/Buffer.h"
+#include "core/OutputQueue.h"
+
+class Strand;
 
 
 namespace utils {
+
+// 连接使用的线协议：连上后由客户端发来的第一段字节决定（见 chat/ChatCodec.h）
+enum class WireProtocol : uint8_t {
+    Unknown,   // 还没收到足够的数据来判断
+    Text,      // 一行一个 JSON
+    Binary,    // 长度前缀二进制帧
+};
     
 /*这个Connection的成员有
 fd,inbuf,outbuf;
@@ -15,18 +28,49 @@ struct Connection
 {
     /*为每个连接创建 Session（会话状态）*/
     int fd{-1};
-    std::string inbuf;
-    std::string outbuf;
+    uint64_t id{0};         // 连接的唯一编号（fd 会被复用，id 不会）
+    Buffer      inbuf;    // 读进来还没拆成完整消息的数据
+    OutputQueue outbuf;   // 还没写出去的回包（一条一块，writev 发送）
 
     // I/O 状态
     std::atomic<bool> wantWrite{false};
     std::atomic<bool> shortClose{false};
+    // closeConn 之后置 true：fd 号可能马上被新连接复用，后续任何读写都要先看它
+    std::atomic<bool> closed{false};
+    // 只在 loop 线程里确定一次，之后业务线程只读（投递任务前就已经定下来了）
+    WireProtocol proto{WireProtocol::Unknown};
+    // 这个连接的请求都经它串行交给线程池：同一时刻最多一个 worker 在处理，
+    // worker 之间不会抢会话状态；但 loop 线程（closeConn / 广播 / 日志）也会读，见下面 Session 状态
+    std::shared_ptr<Strand> strand;
 
-    // Session 状态
+    // 背压：已经交给线程池、回包还没排进 outbuf 的请求数。
+    // loop 线程加；业务线程处理完把回包投递给 loop 之后，再投递一个任务让 loop 线程减（见 Server::finishRequest）
+    std::atomic<int> inflight{0};
+    // 在途请求太多时暂停读这个连接（摘掉 EPOLLIN），只在 loop 线程里改
+    bool readPaused{false};
+
+    // 空闲超时：最后一次读到数据的时间（reactor 的毫秒时钟）和对应的定时器，只在 loop 线程里碰
+    int64_t  lastActiveMs{0};
+    uint64_t idleTimer{0};
+    // 发过心跳的连接由心跳超时（比空闲超时短得多）管，见 Server::sweepDeadSessions
+    bool     heartbeat{false};
+    // 慢消费者：outbuf 积压过了高水位，降回低水位之前不再给它推广播，只在 loop 线程里改
+    bool     slowConsumer{false};
+
+    // Session 状态：由 strand 上的 worker 写。
+    // authed / userId / roomId 还会被 loop 线程读（closeConn 退房间、广播前检查登录、日志），所以是原子的；
+    // name 只在 worker 里读写，loop 线程不碰它
     //标记这个连接的用户是否“已经登录成功”
-    bool authed{false};     // 是否已登录
-    int userId{0};          // 用户ID
-    std::string name;            // 用户名
-    int roomId{0};          // 所在聊天室
+    std::atomic<bool> authed{false};     // 是否已登录
+    std::atomic<int>  userId{0};         // 用户ID
+    std::string name;            // 用户名（只在 worker 里碰）
+    // 所在聊天室 / 正在进的聊天室：strand 上的 worker 写，closeConn（loop 线程）读来退房间。
+    // 进房间时先公布 joiningRoomId 再看 closed，和 closeConn 的“先置 closed 再读房间号”配对，
+    // 两边至少有一边看得到对方，见 MessageHandler.cpp 的 enterRoom
+    std::atomic<int> roomId{0};
+    std::atomic<int> joiningRoomId{0};
 };
+
+// 连接对象会被 loop 线程和业务线程同时引用，用 shared_ptr 管理生命周期
+using ConnectionPtr = std::shared_ptr<Connection>;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""解码结构化二进制日志（logs/nebula.blog）
+
+用法：
+    python3 scripts/logreader.py logs/nebula.blog [--level debug|info|warn|error]
+
+文件格式（整数为小端，和写日志的机器一致）：
+    文件头  "NBLOG1\\n"
+    格式串  F | u32 id | u8 level | u32 line | u16 fileLen | file | u32 fmtLen | fmt
+    记录    R | i64 sec | u8 level | u32 fmtId | u32 argLen | args
+参数编码：1 字节类型 + 原始字节
+    'b' u8 | 'i' i64 | 'u' u64 | 'd' double | 'p' u64 | 's' u32 长度 + 字节
+"""
+import argparse
+import struct
+import sys
+import time
+
+LEVELS = ["DEBUG", "INFO", "WARN", "ERROR"]
+MAGIC = b"NBLOG1\n"
+
+
+def decode_args(buf: bytes):
+    args, pos = [], 0
+    while pos < len(buf):
+        tag = chr(buf[pos])
+        pos += 1
+        if tag == "s":
+            (n,) = struct.unpack_from("<I", buf, pos)
+            pos += 4
+            args.append((tag, buf[pos:pos + n].decode("utf-8", "replace")))
+            pos += n
+        elif tag == "b":
+            args.append((tag, bool(buf[pos])))
+            pos += 1
+        elif tag == "d":
+            args.append((tag, struct.unpack_from("<d", buf, pos)[0]))
+            pos += 8
+        elif tag == "i":
+            args.append((tag, struct.unpack_from("<q", buf, pos)[0]))
+            pos += 8
+        elif tag in ("u", "p"):
+            args.append((tag, struct.unpack_from("<Q", buf, pos)[0]))
+            pos += 8
+        else:
+            raise ValueError("bad arg tag %r" % tag)
+    return args
+
+
+def render(fmt: str, args) -> str:
+    out, i, k = [], 0, 0
+    while i < len(fmt):
+        hexa = fmt.startswith("{:x}", i)
+        if fmt.startswith("{}", i) or hexa:
+            i += 4 if hexa else 2
+            if k >= len(args):
+                out.append("{}")
+                continue
+            tag, v = args[k]
+            k += 1
+            if tag == "b":
+                out.append("true" if v else "false")
+            elif tag == "p":
+                out.append(hex(v))
+            elif hexa and isinstance(v, int):
+                out.append("%x" % (v & 0xFFFFFFFFFFFFFFFF))
+            elif tag == "d":
+                out.append("%g" % v)
+            else:
+                out.append(str(v))
+        else:
+            out.append(fmt[i])
+            i += 1
+    return "".join(out)
+
+
+def read_log(path: str, min_level: int):
+    with open(path, "rb") as f:
+        data = f.read()
+    if not data.startswith(MAGIC):
+        raise SystemExit("%s: not a NebulaChat binary log" % path)
+
+    formats = {}
+    pos = len(MAGIC)
+    while pos < len(data):
+        kind = data[pos:pos + 1]
+        pos += 1
+        if kind == b"F":
+            fid, level, line, flen = struct.unpack_from("<IBIH", data, pos)
+            pos += 11
+            file = data[pos:pos + flen].decode()
+            pos += flen
+            (fmtlen,) = struct.unpack_from("<I", data, pos)
+            pos += 4
+            formats[fid] = (file, line, data[pos:pos + fmtlen].decode("utf-8", "replace"))
+            pos += fmtlen
+        elif kind == b"R":
+            sec, level, fid, alen = struct.unpack_from("<qBII", data, pos)
+            pos += 17
+            args = decode_args(data[pos:pos + alen])
+            pos += alen
+            if level < min_level:
+                continue
+            fmt = formats.get(fid, ("?", 0, "<unknown format %d>" % fid))[2]
+            ts = time.strftime("%Y-%m-%d %H:%M:%S", time.localtime(sec))
+            yield "%s | %s | %s" % (ts, LEVELS[level & 3], render(fmt, args))
+        else:
+            raise SystemExit("%s: corrupt record at offset %d" % (path, pos - 1))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="decode NebulaChat structured binary logs")
+    ap.add_argument("file")
+    ap.add_argument("--level", default="debug", choices=[l.lower() for l in LEVELS])
+    opt = ap.parse_args()
+    min_level = LEVELS.index(opt.level.upper())
+    try:
+        for line in read_log(opt.file, min_level):
+            print(line)
+    except BrokenPipeError:
+        sys.exit(0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,35 @@
+-- NebulaChat 用到的 MySQL 表结构
+-- 用法：mysql -uroot -p < scripts/schema.sql
+
+CREATE DATABASE IF NOT EXISTS serverlogin DEFAULT CHARSET utf8mb4;
+USE serverlogin;
+
+-- 用户：手机号 / 用户名都能登录，各自唯一
+CREATE TABLE IF NOT EXISTS users (
+    id        INT UNSIGNED NOT NULL AUTO_INCREMENT,
+    phone     VARCHAR(20)  NOT NULL,
+    username  VARCHAR(64)  NOT NULL,
+    password  VARCHAR(128) NOT NULL,
+    PRIMARY KEY (id),
+    UNIQUE KEY uk_phone (phone),
+    UNIQUE KEY uk_username (username)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;
+
+-- 聊天消息：id 全部由服务端在进程内分配（见 chat::NextMessageId），写入时总是带显式 id，
+-- 聊天消息从不走 AUTO_INCREMENT（自增会撞上上一个进程已经分配、还在写入队列里的 id）；
+-- 保留 AUTO_INCREMENT 只是为了兼容手工插入 / 老数据
+CREATE TABLE IF NOT EXISTS messages (
+    id          BIGINT UNSIGNED NOT NULL AUTO_INCREMENT,
+    room_id     INT UNSIGNED    NOT NULL,
+    user_id     INT UNSIGNED    NOT NULL,
+    username    VARCHAR(64)     NOT NULL,
+    content     TEXT            NOT NULL,
+    created_at  DATETIME        NOT NULL,
+    PRIMARY KEY (id),
+    -- get_history 的 keyset 翻页：WHERE room_id = ? AND id < ? ORDER BY id DESC LIMIT n
+    -- 直接在这个索引上定位到游标再顺序读一页，翻到多深都不用扫前面的行
+    KEY idx_room_id (room_id, id)
+) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4;
+
+-- 已有的库补索引：
+-- ALTER TABLE messages ADD INDEX idx_room_id (room_id, id);
@@ -4,12 +4,27 @@
 #include "core/Logger.h"
 #include "utils/Random.h"
 #include "utils/UserCacheVal.h"
+#include "utils/SingleFlight.h"
 
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 using namespace utils;
 
+namespace {
+// 一次 DB 查用户的结果：按用户名查时 field 是密码，按手机号查时是用户名
+struct UserLookup {
+    bool        found{false};
+    int         id{0};
+    std::string field;
+};
+
+// 本地 L1 + Redis 都 miss 以后，同一个用户名 / 手机号的并发请求（同一账号多端同时登录、
+// 冷启动时一波重连）只查一次 DB，其它请求等它的结果；不同用户之间并行
+SingleFlight<std::string, UserLookup> g_userByNameFlight;
+SingleFlight<std::string, UserLookup> g_userByPhoneFlight;
+}
+
 // ===================== 用户名 + 密码登录 =====================
 //
 // login 只做“校验密码 + 返回结果”
@@ -386,66 +401,85 @@ bool AuthService::loadUserByName(const std::string& username,
         LOG_WARN("[loadUserByName] redis not available, use DB only");
     }
 
-    if (RedisPool::IsDown()) {
-        if (!g_loginLimiter.allow()) {
-            LOG_WARN("[loadUserName] reject by QPS limiter, username=" << username);
-            return false;
+    // 2) DB：同一个用户名只让一个线程去查
+    UserLookup r = g_userByNameFlight.run(username, [&]() {
+        UserLookup out;
+        // double-check：上一轮加载可能刚刚回写了本地缓存
+        bool localNull = false;
+        if (g_localUserByName.get(username, out.id, out.field, localNull)) {
+            out.found = !localNull;
+            return out;
         }
-    }
-    // 2) DB
-    auto conn = DBPool::Instance().getConnection();
-    if (!conn) {
-        LOG_ERROR("[loadUserByName] no db connection");
-        return false;
-    }
 
-    std::string query_sql =
-        "SELECT id, password FROM users "
-        "WHERE username = '" + username + "' "
-        "LIMIT 1";
+        if (RedisPool::IsDown()) {
+            if (!g_loginLimiter.allow()) {
+                LOG_WARN("[loadUserName] reject by QPS limiter, username=" << username);
+                return out;
+            }
+        }
 
-    MYSQL_RES* res = conn->query(query_sql);
-    if (!res) {
-        LOG_ERROR("[loadUserByName] query failed, user=" << username);
-        return false;
-    }
+        auto conn = DBPool::Instance().getConnection();
+        if (!conn) {
+            LOG_ERROR("[loadUserByName] no db connection");
+            return out;
+        }
 
-    MYSQL_ROW row = mysql_fetch_row(res);
-    if (!row) {
-        LOG_INFO("[loadUserByName] user not exist in DB, user=" << username);
-        mysql_free_result(res);
+        // 登录热路径：预处理语句缓存在连接上，用户名按参数绑定，不拼 SQL
+        PreparedStatement* stmt =
+            conn->prepare("SELECT id, password FROM users WHERE username = ? LIMIT 1");
+        if (!stmt) {
+            LOG_ERROR("[loadUserByName] prepare failed, user=" << username);
+            return out;
+        }
+        stmt->bindString(0, username);
+        if (!stmt->execute()) {
+            LOG_ERROR("[loadUserByName] query failed, user=" << username);
+            return out;
+        }
 
-        if (redisConn) {
-            int ttl = utils::MakeTtlWithJitter(600, 300);
-            redisConn->setEX(key, "null", ttl);
+        if (!stmt->fetch()) {
+            if (!stmt->ok()) {
+                LOG_ERROR("[loadUserByName] fetch failed, user=" << username);
+                return out;
+            }
+            LOG_INFO("[loadUserByName] user not exist in DB, user=" << username);
+
+            if (redisConn) {
+                int ttl = utils::MakeTtlWithJitter(600, 300);
+                redisConn->setEX(key, "null", ttl);
+            }
+            g_localUserByName.putNull(username);
+            return out;
         }
-        g_localUserByName.putNull(username);
-        return false;
-    }
 
-    idOut       = std::stoi(row[0]);
-    passHashOut = row[1] ? row[1] : "";
-    mysql_free_result(res);
+        out.found = true;
+        out.id    = static_cast<int>(stmt->getInt(0));
+        out.field = stmt->getString(1);
 
-    LOG_INFO("[loadUserByName] DB hit, user=" << username << " id=" << idOut);
+        LOG_INFO("[loadUserByName] DB hit, user=" << username << " id=" << out.id);
 
-    // 回写缓存
-    if (redisConn) {
-        try {
-            json j;
-            j["id"]       = idOut;
-            j["username"] = username;
-            j["password"] = passHashOut;
+        // 回写缓存
+        if (redisConn) {
+            try {
+                json j;
+                j["id"]       = out.id;
+                j["username"] = username;
+                j["password"] = out.field;
 
-            int ttl = utils::MakeTtlWithJitter(3600, 600);
-            redisConn->setEX(key, j.dump(), ttl);
-        } catch (const std::exception& e) {
-            LOG_ERROR("[loadUserByName] build redis json fail, user=" << username
-                      << " err=" << e.what());
+                int ttl = utils::MakeTtlWithJitter(3600, 600);
+                redisConn->setEX(key, j.dump(), ttl);
+            } catch (const std::exception& e) {
+                LOG_ERROR("[loadUserByName] build redis json fail, user=" << username
+                          << " err=" << e.what());
+            }
         }
-    }
-    g_localUserByName.put(username, idOut, passHashOut);
+        g_localUserByName.put(username, out.id, out.field);
+        return out;
+    });
 
+    if (!r.found) return false;
+    idOut       = r.id;
+    passHashOut = r.field;
     return true;
 }
 
@@ -504,70 +538,87 @@ bool AuthService::loadUserByPhone(const std::string& phone,
         LOG_WARN("[loadUserByPhone] redis not available, maybe use DB+limit");
     }
 
-    // 2) RedisDown 时：打 DB 前先限流（可选）
-    if (RedisPool::IsDown()) {
-        if (!g_loginLimiter.allow()) {
-            LOG_WARN("[loadUserByPhone] reject by QPS limiter, phone=" << phone);
-            return false;
+    // 2) DB：同一个手机号只让一个线程去查
+    UserLookup r = g_userByPhoneFlight.run(phone, [&]() {
+        UserLookup out;
+        // double-check：上一轮加载可能刚刚回写了本地缓存
+        bool localNull = false;
+        if (g_localUserCacheByPhone.get(phone, out.id, out.field, localNull)) {
+            out.found = !localNull;
+            return out;
         }
-    }
 
-    // 3) DB
-    auto conn = DBPool::Instance().getConnection();
-    if (!conn) {
-        LOG_ERROR("[loadUserByPhone] no db connection");
-        return false;
-    }
+        // RedisDown 时：打 DB 前先限流（可选）
+        if (RedisPool::IsDown()) {
+            if (!g_loginLimiter.allow()) {
+                LOG_WARN("[loadUserByPhone] reject by QPS limiter, phone=" << phone);
+                return out;
+            }
+        }
 
-    std::string sql =
-        "SELECT id, username FROM users "
-        "WHERE phone = '" + phone + "' "
-        "LIMIT 1";
+        auto conn = DBPool::Instance().getConnection();
+        if (!conn) {
+            LOG_ERROR("[loadUserByPhone] no db connection");
+            return out;
+        }
 
-    MYSQL_RES* res = conn->query(sql);
-    if (!res) {
-        LOG_ERROR("[loadUserByPhone] query failed, phone=" << phone);
-        return false;
-    }
+        PreparedStatement* stmt =
+            conn->prepare("SELECT id, username FROM users WHERE phone = ? LIMIT 1");
+        if (!stmt) {
+            LOG_ERROR("[loadUserByPhone] prepare failed, phone=" << phone);
+            return out;
+        }
+        stmt->bindString(0, phone);
+        if (!stmt->execute()) {
+            LOG_ERROR("[loadUserByPhone] query failed, phone=" << phone);
+            return out;
+        }
 
-    MYSQL_ROW row = mysql_fetch_row(res);
-    if (!row) {
-        LOG_INFO("[loadUserByPhone] phone not exist in DB, phone=" << phone);
-        mysql_free_result(res);
+        if (!stmt->fetch()) {
+            if (!stmt->ok()) {
+                LOG_ERROR("[loadUserByPhone] fetch failed, phone=" << phone);
+                return out;
+            }
+            LOG_INFO("[loadUserByPhone] phone not exist in DB, phone=" << phone);
 
-        if (redisConn) {
-            int ttl = utils::MakeTtlWithJitter(600, 300);
-            redisConn->setEX(key, "null", ttl);
+            if (redisConn) {
+                int ttl = utils::MakeTtlWithJitter(600, 300);
+                redisConn->setEX(key, "null", ttl);
+            }
+            g_localUserCacheByPhone.putNull(phone);
+            return out;
         }
-        g_localUserCacheByPhone.putNull(phone);
-        return false;
-    }
 
-    idOut = std::stoi(row[0]);
-    usernameOut = row[1] ? row[1] : "";
-    mysql_free_result(res);
+        out.found = true;
+        out.id    = static_cast<int>(stmt->getInt(0));
+        out.field = stmt->getString(1);
 
-    LOG_INFO("[loadUserByPhone] DB hit, phone=" << phone
-             << " id=" << idOut
-             << " username=" << usernameOut);
+        LOG_INFO("[loadUserByPhone] DB hit, phone=" << phone
+                 << " id=" << out.id
+                 << " username=" << out.field);
 
-    // 回写缓存
-    if (redisConn) {
-        try {
-            json j;
-            j["id"]       = idOut;
-            j["username"] = usernameOut;
-            j["phone"]    = phone;
+        // 回写缓存
+        if (redisConn) {
+            try {
+                json j;
+                j["id"]       = out.id;
+                j["username"] = out.field;
+                j["phone"]    = phone;
 
-            int ttl = utils::MakeTtlWithJitter(3600, 600);
-            redisConn->setEX(key, j.dump(), ttl);
-        } catch (const std::exception& e) {
-            LOG_ERROR("[loadUserByPhone] build redis json fail, phone=" << phone
-                      << " err=" << e.what());
+                int ttl = utils::MakeTtlWithJitter(3600, 600);
+                redisConn->setEX(key, j.dump(), ttl);
+            } catch (const std::exception& e) {
+                LOG_ERROR("[loadUserByPhone] build redis json fail, phone=" << phone
+                          << " err=" << e.what());
+            }
         }
-    }
-    g_localUserCacheByPhone.put(phone, idOut, usernameOut);
+        g_localUserCacheByPhone.put(phone, out.id, out.field);
+        return out;
+    });
 
+    if (!r.found) return false;
+    idOut       = r.id;
+    usernameOut = r.field;
     return true;
 }
 
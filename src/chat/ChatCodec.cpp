@@ -0,0 +1,223 @@
+#include "chat/ChatCodec.h"
+#include "core/Logger.h"
+#include <cstring>
+#include <algorithm>
+
+namespace chat {
+
+namespace {
+// ===== 大端整数读写 =====
+void putU16(std::string& out, uint16_t v) {
+    out.push_back(static_cast<char>(v >> 8));
+    out.push_back(static_cast<char>(v));
+}
+void putU32(std::string& out, uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<char>(v >> shift));
+}
+void putI64(std::string& out, int64_t v) {
+    uint64_t u = static_cast<uint64_t>(v);
+    for (int shift = 56; shift >= 0; shift -= 8) out.push_back(static_cast<char>(u >> shift));
+}
+uint32_t readU32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16) |
+           (static_cast<uint32_t>(u[2]) << 8)  |  static_cast<uint32_t>(u[3]);
+}
+int64_t readI64(const char* p) {
+    return static_cast<int64_t>((static_cast<uint64_t>(readU32(p)) << 32) | readU32(p + 4));
+}
+
+// 先占好 4 字节长度 + opcode，正文写完再回填长度，避免正文多拷一次
+std::string beginFrame(uint8_t op, size_t payloadHint) {
+    std::string out;
+    out.reserve(kFrameHeaderLen + 1 + payloadHint);
+    out.append(kFrameHeaderLen, '\0');
+    out.push_back(static_cast<char>(op));
+    return out;
+}
+void finishFrame(std::string& frame) {
+    uint32_t len = static_cast<uint32_t>(frame.size() - kFrameHeaderLen);
+    for (int i = 0; i < 4; ++i) frame[i] = static_cast<char>(len >> (24 - 8 * i));
+}
+
+std::string jsonFrame(const json& resp) {
+    std::string text = resp.dump(-1, ' ', false, json::error_handler_t::replace);
+    std::string frame = beginFrame(OP_JSON, text.size());
+    frame += text;
+    finishFrame(frame);
+    return frame;
+}
+
+// 回包里的字符串字段：缺了或者不是字符串返回 nullptr。
+// const json 上用 operator[] 取不存在的 key 是未定义行为，get_ref 类型不对会抛异常，
+// 这里是业务已经处理完、在 worker 里编码回包，抛出去客户端就永远等不到回包了
+const std::string* stringField(const json& resp, const char* key) {
+    auto it = resp.find(key);
+    if (it == resp.end() || !it->is_string()) return nullptr;
+    return &it->get_ref<const std::string&>();
+}
+
+// 紧凑格式编不出来（字段缺了 / 类型不对）：回一个 OP_JSON 错误帧，至少让客户端知道这条请求失败了
+std::string badResponseFrame(uint8_t op, const char* field) {
+    LOG_ERROR("[ChatCodec] cannot encode op=" << static_cast<int>(op)
+              << ": field '" << field << "' missing or of wrong type");
+    static const json err = {{"ok", false}, {"err", "bad response"}};
+    return jsonFrame(err);
+}
+
+// u16 nameLen | name；名字超长就截断（正常不会出现）
+void putName(std::string& out, const std::string& name) {
+    size_t n = std::min<size_t>(name.size(), 0xFFFF);
+    putU16(out, static_cast<uint16_t>(n));
+    out.append(name, 0, n);
+}
+}
+
+WireProtocol detectProtocol(const char* data, size_t len) {
+    if (len == 0) return WireProtocol::Unknown;
+    // JSON 行不可能以 'N' 开头，第一个字节不是 'N' 就可以直接判定为文本协议
+    size_t n = std::min(len, sizeof(kBinaryMagic));
+    if (std::memcmp(data, kBinaryMagic, n) != 0) return WireProtocol::Text;
+    return n == sizeof(kBinaryMagic) ? WireProtocol::Binary : WireProtocol::Unknown;
+}
+
+FrameStatus takeFrame(Buffer& inbuf, uint8_t& op, std::string& payload) {
+    if (inbuf.readableBytes() < kFrameHeaderLen) return FrameStatus::NeedMore;
+    uint32_t len = readU32(inbuf.peek());
+    if (len == 0 || len > kMaxFrameLen) return FrameStatus::Bad;
+    if (inbuf.readableBytes() < kFrameHeaderLen + len) return FrameStatus::NeedMore;
+
+    const char* body = inbuf.peek() + kFrameHeaderLen;
+    op = static_cast<uint8_t>(body[0]);
+    payload.assign(body + 1, len - 1);
+    inbuf.retrieve(kFrameHeaderLen + len);
+    return FrameStatus::Ok;
+}
+
+bool decodeRequest(uint8_t op, const std::string& payload, json& req) {
+    switch (op) {
+    case OP_JSON:
+        req = json::parse(payload, nullptr, false);   // 不抛异常，失败得到 discarded
+        return !req.is_discarded() && req.is_object();
+    case OP_ECHO:
+        req = json{{"cmd", "echo"}, {"msg", payload}};
+        return true;
+    case OP_SEND:
+        req = json{{"cmd", "send_msg"}, {"text", payload}};
+        return true;
+    case OP_PING:
+        req = json{{"cmd", "ping"}};
+        return true;
+    case OP_HIST:
+        if (payload.size() != 4 && payload.size() != 20) return false;
+        req = json{{"cmd", "get_history"},
+                   {"limit", static_cast<int>(readU32(payload.data()))}};
+        if (payload.size() == 20) {
+            req["before_id"] = readI64(payload.data() + 4);
+            req["after_id"]  = readI64(payload.data() + 12);
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+std::string encodeTextLine(const json& resp) {
+    // 二进制客户端发来的文本可能不是合法 UTF-8，这里替换掉而不是抛异常
+    return resp.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+}
+
+std::string encodeChatFrame(const json& resp) {
+    const std::string* namePtr = stringField(resp, "fromName");
+    if (!namePtr) return badResponseFrame(OP_CHAT, "fromName");
+    const std::string* textPtr = stringField(resp, "text");
+    if (!textPtr) return badResponseFrame(OP_CHAT, "text");
+    const std::string& name = *namePtr;
+    const std::string& text = *textPtr;
+
+    std::string frame = beginFrame(OP_CHAT, 4 + 8 + 4 + 8 + 2 + name.size() + text.size());
+    putU32(frame, static_cast<uint32_t>(resp.value("roomId", 0)));
+    putI64(frame, resp.value("id", 0LL));   // 客户端翻历史的游标，和 OP_HIST_RESP 里的 id 一样
+    putU32(frame, static_cast<uint32_t>(resp.value("fromId", 0)));
+    putI64(frame, resp.value("ts", 0LL));
+    putName(frame, name);
+    frame += text;
+    finishFrame(frame);
+    return frame;
+}
+
+std::string encodeBinaryResponse(uint8_t reqOp, const json& resp) {
+    if (!resp.value("ok", false)) return jsonFrame(resp);
+
+    switch (reqOp) {
+    case OP_ECHO: {
+        const std::string* data = stringField(resp, "data");
+        if (!data) return badResponseFrame(OP_ECHO, "data");
+        std::string frame = beginFrame(OP_ECHO, data->size());
+        frame += *data;
+        finishFrame(frame);
+        return frame;
+    }
+    case OP_SEND:
+        return encodeChatFrame(resp);
+    case OP_HIST: {
+        auto it = resp.find("history");
+        if (it == resp.end() || !it->is_array()) return badResponseFrame(OP_HIST_RESP, "history");
+        const json& history = *it;
+        std::string frame = beginFrame(OP_HIST_RESP, 8 + history.size() * 68);
+        putU32(frame, static_cast<uint32_t>(resp.value("roomId", 0)));
+        putU32(frame, static_cast<uint32_t>(history.size()));
+        for (const auto& item : history) {
+            // 缓存里的历史可能是旧版本写进去的，字段缺了也不能崩
+            std::string text = item.value("text", std::string());
+            putI64(frame, item.value("id", 0LL));   // messages.id 是 BIGINT，不能截成 32 位
+            putU32(frame, static_cast<uint32_t>(item.value("fromId", 0)));
+            putI64(frame, item.value("ts", 0LL));
+            putName(frame, item.value("fromName", std::string()));
+            putU32(frame, static_cast<uint32_t>(text.size()));
+            frame += text;
+        }
+        finishFrame(frame);
+        return frame;
+    }
+    case OP_PING: {
+        std::string frame = beginFrame(OP_PONG, 0);
+        finishFrame(frame);
+        return frame;
+    }
+    default:
+        return jsonFrame(resp);
+    }
+}
+
+bool isPing(uint8_t op, const char* data, size_t len) {
+    if (op == OP_PING) return true;
+    if (op != OP_TEXT && op != OP_JSON) return false;
+
+    // 去掉空白后必须正好是 {"cmd":"ping"}；带了别的字段（seq 之类）就走正常的命令分发
+    static constexpr char kPing[] = "{\"cmd\":\"ping\"}";
+    constexpr size_t kPingLen = sizeof(kPing) - 1;
+    if (len < kPingLen || len > 64) return false;
+
+    size_t k = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char ch = data[i];
+        if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') continue;
+        if (k == kPingLen || ch != kPing[k]) return false;
+        ++k;
+    }
+    return k == kPingLen;
+}
+
+std::string encodePong(uint8_t reqOp) {
+    static const json pong = {{"ok", true}, {"cmd", "pong"}};
+    if (reqOp == OP_TEXT) return encodeTextLine(pong);
+    return encodeBinaryResponse(reqOp, pong);
+}
+
+std::string encodePush(WireProtocol proto, const json& msg) {
+    if (proto == WireProtocol::Binary) return jsonFrame(msg);
+    return encodeTextLine(msg);
+}
+
+}
@@ -1,10 +1,16 @@
 #include "chat/ChatHistory.h"
+#include "chat/MessageWriter.h"
+#include "chat/RecentMessages.h"
 #include "db/DBpool.h"
 #include "db/RedisPool.h"
 #include "core/Logger.h"
 #include "utils/Random.h"
+#include "utils/SingleFlight.h"
 
 #include <mysql/mysql.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
 #include <mutex>
 
 namespace chat {
@@ -15,126 +21,176 @@ namespace {
 
 // 默认一次拉多少条历史
 constexpr int DEFAULT_HISTORY_LIMIT      = 50;
-// 单次最多允许客户端要多少条
-constexpr int MAX_HISTORY_LIMIT          = 200;
-// 缓存基础 TTL（秒）
-constexpr int HISTORY_CACHE_BASE_TTL     = 60;
-// 在基础 TTL 上增加一个 0~30 秒的随机值，防止雪崩
-constexpr int HISTORY_CACHE_JITTER       = 30;
+// 单次最多允许客户端要多少条（和内存环一样大，任何 limit 都能直接从环里拿）
+constexpr int MAX_HISTORY_LIMIT          = static_cast<int>(RecentMessages::kCapacity);
 
-// 简单互斥锁：防止缓存未命中时被大量并发打爆 DB
-std::mutex g_historyMutex;
+// 翻页缓存基础 TTL（秒）：游标之前的历史不会再变，可以存久一点
+constexpr int HISTORY_PAGE_CACHE_BASE_TTL = 300;
+// 在基础 TTL 上增加一个 0~60 秒的随机值，防止雪崩
+constexpr int HISTORY_PAGE_CACHE_JITTER   = 60;
+
+// 冷房间第一次读 / 翻页缓存未命中的时候防击穿：同一个房间 / 同一页只让一个线程去 DB，
+// 其它线程等它的结果；不同房间、不同页并行加载
+using HistoryPage = std::shared_ptr<const json>;   // 加载失败是 nullptr
+utils::SingleFlight<int, HistoryPage> g_warmFlight;
+utils::SingleFlight<std::string, HistoryPage> g_pageFlight;
 
 // 降级状态：true 表示 Redis 现在认为是“坏掉的”
 std::atomic<bool> g_redisBroken{false};
 
-// 当 Redis 坏掉时，用这个锁串行访问 DB，避免 DB 被大量并发压死
-std::mutex g_fallbackDbMutex;
-
-// 简单的“DB 回退 QPS”计数器
+// Redis 坏掉时同时打 DB 的翻页加载数（同一页已经合并成一次了，这里限制的是不同页）
 std::atomic<int> g_fallbackQps{0};
-constexpr int MAX_FALLBACK_QPS = 50; // 每秒最多允许 50 次回退 DB
-
-// 用 mysql_real_escape_string 做一下转义，防止聊天内容里的单引号把 SQL 搞坏,这个就是预防sql注入的
-std::string escapeForSql(MYSQL* conn, const std::string& s) {
-    if (!conn || s.empty()) return s;
-
-    // mysql_real_escape_string 最多把长度扩大一倍 + 1
-    std::string out;
-    out.resize(s.size() * 2 + 1);
-
-    unsigned long len = mysql_real_escape_string(
-        conn,
-        &out[0],
-        s.c_str(),
-        static_cast<unsigned long>(s.size())
-    );
-    out.resize(len);
-    return out;
-}
-
-// 从 DB 里拉最近 limit 条历史消息
-json loadHistoryFromDB(int roomId, int limit) {
-    json history = json::array();
+constexpr int MAX_FALLBACK_QPS = 50; // 同时最多允许 50 个翻页请求回退 DB
+
+// 消息 id 分配：落库是异步的，拿不到自增 id，所以在进程内分配
+std::mutex g_idSeedMutex;
+std::atomic<int64_t> g_nextMessageId{0};
+// 从 DB 的 MAX(id) 往后跳一段再开始：热重启时旧进程可能还有没落库的消息占着 MAX(id) 后面的 id，
+// 跳过的量要大于它写入队列的容量
+constexpr int64_t kMessageIdSeedGap = 1 << 17;
+// 起点至少是“启动时的毫秒时间戳 × kIdsPerMs”：DB 连不上读不到 MAX(id) 也能起步，
+// 而且后启动的进程起点更大——前一个进程平均每毫秒发不到 kIdsPerMs 条就追不上它。
+// 所有消息都带显式 id 落库，不再和 DB 自增 id 混用（自增会撞上别的进程已经分配、还没落库的 id）
+constexpr int64_t kIdsPerMs = 1024;
+
+// 从 DB 里拉一页历史消息（最新在前）；查询失败返回 false
+// 走 messages(room_id, id) 索引的 keyset 查询，不用 OFFSET，翻到多深都只扫一页的行：
+//   beforeId > 0：id < beforeId 的最新 limit 条
+//   afterId  > 0：id > afterId 的最老 limit 条（查出来是从老到新，最后翻过来）
+//   都是 0：最新 limit 条
+bool loadHistoryFromDB(int roomId, int limit, int64_t beforeId, int64_t afterId, json& history) {
+    history = json::array();
 
     auto dbConn = DBPool::Instance().getConnection();
     if (!dbConn) {
         LOG_ERROR("[ChatHistory::loadHistoryFromDB] no db connection");
-        return history;
+        return false;
     }
 
     if (limit <= 0) limit = DEFAULT_HISTORY_LIMIT;
-    if (limit > MAX_HISTORY_LIMIT) limit = MAX_HISTORY_LIMIT;
 
+    // 三种翻页方向各一条预处理语句（缓存在连接上），房间号 / 游标 / limit 都按参数绑定
     std::string sql =
         "SELECT id, user_id, username, content, UNIX_TIMESTAMP(created_at) "
         "FROM messages "
-        "WHERE room_id = " + std::to_string(roomId) + " "
-        "ORDER BY id DESC "
-        "LIMIT " + std::to_string(limit);
-
-    MYSQL_RES* res = dbConn->query(sql);
-    if (!res) {
-        LOG_ERROR("[ChatHistory::loadHistoryFromDB] query failed, sql=" << sql);
-        return history;
+        "WHERE room_id = ?";
+    if (afterId > 0) {
+        sql += " AND id > ? ORDER BY id ASC";
+    } else {
+        if (beforeId > 0) sql += " AND id < ?";
+        sql += " ORDER BY id DESC";
+    }
+    sql += " LIMIT ?";
+
+    PreparedStatement* stmt = dbConn->prepare(sql);
+    if (!stmt) {
+        LOG_ERROR("[ChatHistory::loadHistoryFromDB] prepare failed, sql=" << sql);
+        return false;
+    }
+    unsigned idx = 0;
+    stmt->bindInt(idx++, roomId);
+    if (afterId > 0)       stmt->bindInt(idx++, afterId);
+    else if (beforeId > 0) stmt->bindInt(idx++, beforeId);
+    stmt->bindInt(idx++, limit);
+    if (!stmt->execute()) {
+        LOG_ERROR("[ChatHistory::loadHistoryFromDB] query failed, room=" << roomId
+                  << " before=" << beforeId << " after=" << afterId);
+        return false;
     }
 
-    MYSQL_ROW row;
-    while ((row = mysql_fetch_row(res)) != nullptr) {
+    while (stmt->fetch()) {
         json item;
-        // id
-        item["id"]       = row[0] ? std::atoi(row[0]) : 0;
-        // user_id
-        item["fromId"]   = row[1] ? std::atoi(row[1]) : 0;
-        // username
-        item["fromName"] = row[2] ? row[2] : "";
-        // content
-        item["text"]     = row[3] ? row[3] : "";
+        item["id"]       = stmt->getInt(0);
+        item["fromId"]   = static_cast<int>(stmt->getInt(1));
+        item["fromName"] = stmt->getString(2);
+        item["text"]     = stmt->getString(3);
         // created_at 时间戳（秒）
-        long long ts     = row[4] ? std::atoll(row[4]) : 0;
-        item["ts"]       = ts;
+        item["ts"]       = stmt->getInt(4);
         // 房间号
         item["roomId"]   = roomId;
 
         history.push_back(std::move(item));
     }
+    if (!stmt->ok()) {
+        LOG_ERROR("[ChatHistory::loadHistoryFromDB] fetch failed, room=" << roomId);
+        return false;
+    }
 
-    mysql_free_result(res);
+    // 统一成“最新在前”
+    if (afterId > 0) std::reverse(history.begin(), history.end());
 
-    // 现在 history 是“最新在前”
-    // std::reverse(history.begin(), history.end());
+    return true;
+}
+
+// 翻页缓存的 key：同一个游标 + limit 就是同一页
+std::string pageCacheKey(int roomId, int limit, int64_t beforeId, int64_t afterId) {
+    std::string key = "room:history:" + std::to_string(roomId);
+    key += beforeId > 0 ? ":before:" + std::to_string(beforeId)
+                        : ":after:" + std::to_string(afterId);
+    key += ":" + std::to_string(limit);
+    return key;
+}
 
-    return history;
+bool readCachedPage(RedisConnection& redis, const std::string& key, json& historyOut) {
+    std::string cached;
+    if (!redis.get(key, cached)) return false;
+    json page = json::parse(cached, nullptr, false);
+    if (page.is_discarded() || !page.is_array()) {
+        LOG_ERROR("[ChatHistory::readCachedPage] bad cached page, key=" << key);
+        return false;
+    }
+    historyOut = std::move(page);
+    return true;
 }
 } // anonymous namespace
-// 把一条聊天消息写入 messages 表
-void SaveMessage(int roomId,
+int64_t NextMessageId() {
+    if (g_nextMessageId.load(std::memory_order_acquire) == 0) {
+        std::lock_guard<std::mutex> lock(g_idSeedMutex);
+        if (g_nextMessageId.load(std::memory_order_relaxed) == 0) {
+            int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                std::chrono::system_clock::now().time_since_epoch()).count();
+            int64_t seed = nowMs * kIdsPerMs;
+
+            // 时钟被往回拨过也不能比 DB 里已有的小
+            auto dbConn = DBPool::Instance().getConnection();
+            MYSQL_RES* res = dbConn ? dbConn->query("SELECT IFNULL(MAX(id), 0) FROM messages")
+                                    : nullptr;
+            if (res) {
+                MYSQL_ROW row = mysql_fetch_row(res);
+                int64_t maxId = (row && row[0]) ? std::atoll(row[0]) : 0;
+                mysql_free_result(res);
+                seed = std::max(seed, maxId + kMessageIdSeedGap);
+            } else {
+                LOG_WARN("[ChatHistory::NextMessageId] cannot read MAX(id), start from the clock");
+            }
+            g_nextMessageId.store(seed, std::memory_order_release);
+            LOG_INFO("[ChatHistory::NextMessageId] message ids start from " << seed);
+        }
+    }
+    return g_nextMessageId.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 把一条聊天消息放进房间的内存环，再交给写线程，由它和别的消息攒成一批写入 messages 表
+bool SaveMessage(int64_t id,
+                 int roomId,
                  int userId,
                  const std::string& username,
-                 const std::string& text)
+                 const std::string& text,
+                 int64_t ts)
 {
-    auto dbConn = DBPool::Instance().getConnection();
-    if (!dbConn) {
-        LOG_ERROR("[ChatHistory::SaveMessage] no db connection");
-        return;
-    }
-
-    MYSQL* raw = dbConn->raw();
-    std::string escName = escapeForSql(raw, username);
-    std::string escText = escapeForSql(raw, text);
-
-    std::string sql =
-        "INSERT INTO messages(room_id, user_id, username, content) VALUES(" +
-        std::to_string(roomId) + ", " +
-        std::to_string(userId) + ", '" +
-        escName + "', '" + escText + "')";
-
-    if (!dbConn->update(sql)) {
-        LOG_ERROR("[ChatHistory::SaveMessage] update failed, sql=" << sql);
-    }
+    json item;
+    item["id"]       = id;
+    item["fromId"]   = userId;
+    item["fromName"] = username;
+    item["text"]     = text;
+    item["ts"]       = ts;
+    item["roomId"]   = roomId;
+    RecentMessages::Instance().append(roomId, std::move(item));
+
+    return MessageWriter::Instance().enqueue(id, roomId, userId, username, text, ts);
 }
 
-// 带缓存 + 互斥锁防缓存击穿的历史消息获取
+// 历史消息：最近 MAX_HISTORY_LIMIT 条都在房间的内存环里，只有冷房间第一次读才去 DB
 bool GetHistoryWithCache(int roomId,
                          int limit,
                          json& historyOut)
@@ -143,76 +199,106 @@ bool GetHistoryWithCache(int roomId,
     if (limit <= 0)  limit  = DEFAULT_HISTORY_LIMIT;
     if (limit > MAX_HISTORY_LIMIT) limit = MAX_HISTORY_LIMIT;
 
-    auto redisConn = RedisPool::Instance().getConnection();
-    std::string cacheKey =
-        "room:history:" + std::to_string(roomId) + ":" + std::to_string(limit);
+    RecentMessages& recent = RecentMessages::Instance();
+    if (recent.get(roomId, limit, historyOut)) return true;
+
+    // 拿到的是这个房间最近一环的消息（加载失败是 nullptr）。一般已经 warm 进环了，从环里取；
+    // 环被淘汰过、还有没落库的消息不在环里时 warm 不了，这次直接用它
+    HistoryPage rows = g_warmFlight.run(roomId, [&]() -> HistoryPage {
+        auto loaded = std::make_shared<json>();
+        // double-check：上一轮加载可能刚刚把这个房间填好
+        if (recent.get(roomId, MAX_HISTORY_LIMIT, *loaded)) return loaded;
+
+        // 一次拉满整个环，之后任何 limit 都不用再查 DB
+        int64_t durable = MessageWriter::Instance().durableBelow(roomId);
+        if (!loadHistoryFromDB(roomId, MAX_HISTORY_LIMIT, 0, 0, *loaded)) return nullptr;
+        recent.warm(roomId, *loaded, durable);
+        return loaded;
+    });
+    if (!rows) return false;
+    if (recent.get(roomId, limit, historyOut)) return true;
+
+    historyOut = json::array();
+    for (const auto& item : *rows) {
+        if (historyOut.size() >= static_cast<size_t>(limit)) break;
+        historyOut.push_back(item);
+    }
+    return true;
+}
 
-    // 1) Redis 可用，先尝试直接读缓存
-    if (redisConn) {
-        std::string cached;
-        if (redisConn->get(cacheKey, cached)) {
-            try {
-                historyOut = json::parse(cached);
-                return true;
-            } catch (const std::exception& e) {
-                LOG_ERROR("[ChatHistory::GetHistoryWithCache] parse redis json fail: "
-                          << e.what());
-            }
-        }
+// 游标翻页：环里够回答就直接给，翻到环外面的老消息走 Redis 页缓存 + DB keyset 查询
+bool GetHistoryPage(int roomId,
+                    int limit,
+                    int64_t beforeId,
+                    int64_t afterId,
+                    json& historyOut)
+{
+    if (beforeId <= 0 && afterId <= 0) return GetHistoryWithCache(roomId, limit, historyOut);
 
-        // 2) 缓存 MISS → 加锁防缓存击穿
-        {
-            std::unique_lock<std::mutex> lk(g_historyMutex);
-
-            // 2.1 double-check：锁内再查一次缓存，防止别的线程刚刚填好了
-            std::string cached2;
-            if (redisConn->get(cacheKey, cached2)) {
-                try {
-                    historyOut = json::parse(cached2);
-                    return true;
-                } catch (const std::exception& e) {
-                    LOG_ERROR("[ChatHistory::GetHistoryWithCache] parse redis json (2) fail: "
-                              << e.what());
-                }
-            }
+    if (roomId <= 0) roomId = 1;
+    if (limit <= 0)  limit  = DEFAULT_HISTORY_LIMIT;
+    if (limit > MAX_HISTORY_LIMIT) limit = MAX_HISTORY_LIMIT;
 
-            // 2.2 仍然没有 → 打 DB
-            historyOut = loadHistoryFromDB(roomId, limit);
-
-            // 2.3 写回 Redis，加随机 TTL 防雪崩
-            try {
-                int ttl = HISTORY_CACHE_BASE_TTL
-                          + utils::RandInt(0, HISTORY_CACHE_JITTER);
-                redisConn->setEX(cacheKey, historyOut.dump(), ttl);
-            } catch (const std::exception& e) {
-                LOG_ERROR("[ChatHistory::GetHistoryWithCache] set redis cache fail: "
-                          << e.what());
-            }
+    // 1) 最近的几页都在内存环里
+    if (RecentMessages::Instance().getPage(roomId, limit, beforeId, afterId, historyOut)) {
+        return true;
+    }
 
-            return true;
+    // 2) Redis 可用：按游标缓存整页
+    std::string cacheKey = pageCacheKey(roomId, limit, beforeId, afterId);
+    auto redisConn = RedisPool::Instance().getConnection();
+    if (redisConn) {
+        if (g_redisBroken.exchange(false)) {
+            LOG_INFO("[ChatHistory::GetHistoryPage] redis is back, page cache enabled");
         }
+        if (readCachedPage(*redisConn, cacheKey, historyOut)) return true;
+    } else if (!g_redisBroken.exchange(true)) {
+        // Redis 不可用：进入“降级模式”，直接打 DB
+        LOG_WARN("[ChatHistory::GetHistoryPage] redis not available, fallback DB only");
     }
 
-    //3) Redis 不可用：进入“降级模式”
-    g_redisBroken.store(true);
-    LOG_WARN("[ChatHistory::GetHistoryWithCache] redis not available, fallback DB only");
-
-    // 3.1 简单限流：如果当前回退请求数太多，直接拒绝，避免 DB 被打爆
-    int cur = g_fallbackQps.fetch_add(1);
-    if (cur > MAX_FALLBACK_QPS) {
-        g_fallbackQps.fetch_sub(1);
-        LOG_WARN("[ChatHistory::GetHistoryWithCache] fallback DB qps too high, reject");
-        return false;  // 上层会返回 get history failed
-    }
+    // 3) 缓存未命中：同一页的并发请求只打一次 DB
+    HistoryPage page = g_pageFlight.run(cacheKey, [&]() -> HistoryPage {
+        auto rows = std::make_shared<json>();
+        // double-check：上一轮加载可能刚刚把这一页写进缓存
+        if (redisConn && readCachedPage(*redisConn, cacheKey, *rows)) return rows;
+
+        if (!redisConn) {
+            // 降级模式下简单限流：同时回退的请求太多直接拒绝，避免 DB 被打爆
+            if (g_fallbackQps.fetch_add(1) >= MAX_FALLBACK_QPS) {
+                g_fallbackQps.fetch_sub(1);
+                LOG_WARN("[ChatHistory::GetHistoryPage] fallback DB qps too high, reject");
+                return nullptr;  // 上层会返回 get history failed
+            }
+            bool ok = loadHistoryFromDB(roomId, limit, beforeId, afterId, *rows);
+            g_fallbackQps.fetch_sub(1);
+            return ok ? rows : nullptr;
+        }
 
-    // 3.2 串行访问 DB：所有回退请求都排队访问 DB
-    {
-        std::lock_guard<std::mutex> lock(g_fallbackDbMutex);
-        historyOut = loadHistoryFromDB(roomId, limit);
-    }
+        // 落库是异步的、几个写线程乱序写：查 DB 之前先记下这个房间哪个 id 以下已经全部落库，
+        // 页里还可能有没写进去的空洞就只返回、不缓存，免得把空洞缓存上 5 分钟
+        int64_t durable = MessageWriter::Instance().durableBelow(roomId);
+        if (!loadHistoryFromDB(roomId, limit, beforeId, afterId, *rows)) return nullptr;
+
+        // before 页：游标之前的消息都落库了就不会再变，整页可以缓存；
+        // after 页只有满页、且最新一条之前都落库了才缓存，不满说明翻到了最新，后面还会有新消息进来
+        bool settled = beforeId > 0
+            ? beforeId <= durable
+            : rows->size() >= static_cast<size_t>(limit) &&
+              rows->front().value("id", 0LL) < durable;
+        if (settled) {
+            int ttl = utils::MakeTtlWithJitter(HISTORY_PAGE_CACHE_BASE_TTL,
+                                               HISTORY_PAGE_CACHE_JITTER);
+            if (!redisConn->setEX(cacheKey, rows->dump(), ttl)) {
+                LOG_ERROR("[ChatHistory::GetHistoryPage] set redis cache fail, key=" << cacheKey);
+            }
+        }
+        return rows;
+    });
 
-    g_fallbackQps.fetch_sub(1);
-    return true;    
+    if (!page) return false;
+    historyOut = *page;
+    return true;
 }
 
 } // namespace chat
@@ -3,415 +3,571 @@
 #include "chat/ChatHistory.h"
 #include <iostream>
 #include <chrono>
+#include <array>
+#include <string_view>
 
 constexpr int MAX_ROOM_SIZE = 100;
 
 using json = nlohmann::json;
 
-std::string MessageHandler::handleMessage(Connection& c, const std::string& line) {
+namespace {
+RoomMember memberOf(const Connection& c) {
+    return RoomMember{c.fd, c.id};
+}
+
+// 进房间；如果这时连接已经被 loop 关掉了（closeConn 已经做过 leaveRoom），
+// 要把刚加进去的成员再撤掉，否则房间里会留下一个死成员。
+// 先把目标房间公布到 joiningRoomId 再加成员、再看 closed：closeConn 是先置 closed 再读房间号，
+// 两边都是 seq_cst，要么这里看到 closed 自己撤，要么 closeConn 看到 joiningRoomId 替我们撤。
+// 成功后由调用方退掉旧房间、写 roomId，最后用 settleRoom 清掉 joiningRoomId
+bool enterRoom(Connection& c, int roomId) {
+    auto& roomMgr = RoomManager::Instance();
+    c.joiningRoomId.store(roomId);
+    if (!roomMgr.tryEnterRoom(roomId, memberOf(c), MAX_ROOM_SIZE)) {
+        c.joiningRoomId.store(0);
+        return false;
+    }
+    if (c.closed) {
+        roomMgr.leaveRoom(roomId, memberOf(c));
+        c.joiningRoomId.store(0);
+        return false;
+    }
+    return true;
+}
+
+// 房间切换完成：先写 roomId 再清 joiningRoomId，中间任何时刻 closeConn 都能读到新房间
+void settleRoom(Connection& c, int roomId) {
+    c.roomId.store(roomId);
+    c.joiningRoomId.store(0);
+}
+}
+
+HandlerResult MessageHandler::handleLine(Connection& c, const std::string& line) {
+    try {
+        return handleRequest(c, json::parse(line));
+    } catch (const std::exception& e) {
+        json resp;
+        resp["ok"]  = false;
+        resp["err"] = e.what();
+        return resp;
+    }
+}
+
+/*命令表：新增命令只要在这里加一行，再写一个 cmdXxx 成员函数
+needAuth = false 的命令未登录也能执行（login / register / reset_pass）
+
+查找用编译期算好的完美哈希：FNV-1a(name, seed) % kSlots 在表里两两不冲突，
+一次哈希 + 一次字符串比较就能定位，不管命令排在第几个、将来加多少个，热点命令都不会变慢。*/
+struct CommandTable {
+    static constexpr MessageHandler::Command kCommands[] = {
+        {"send_msg",    true,  &MessageHandler::cmdSendMsg},
+        {"echo",        true,  &MessageHandler::cmdEcho},
+        {"get_history", true,  &MessageHandler::cmdGetHistory},
+        {"join_room",   true,  &MessageHandler::cmdJoinRoom},
+        {"upper",       true,  &MessageHandler::cmdUpper},
+        {"quit",        true,  &MessageHandler::cmdQuit},
+        {"update_name", true,  &MessageHandler::cmdUpdateName},
+        {"login",       false, &MessageHandler::cmdLogin},
+        {"register",    false, &MessageHandler::cmdRegister},
+        {"reset_pass",  false, &MessageHandler::cmdResetPass},
+        {"ping",        false, &MessageHandler::cmdPing},
+    };
+};
+
+namespace {
+constexpr size_t   kCommandCount = sizeof(CommandTable::kCommands) / sizeof(CommandTable::kCommands[0]);
+constexpr size_t   kSlots        = 32;   // 2 的幂，取模就是与运算
+constexpr uint32_t kNoSeed       = 0xFFFFFFFFu;
+
+constexpr uint32_t hashName(std::string_view s, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char ch : s) {
+        h ^= static_cast<unsigned char>(ch);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 编译期找一个让所有命令名都落在不同槽里的 seed
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 0; seed < 4096; ++seed) {
+        bool used[kSlots] = {};
+        bool ok = true;
+        for (size_t i = 0; i < kCommandCount && ok; ++i) {
+            size_t slot = hashName(CommandTable::kCommands[i].name, seed) % kSlots;
+            ok = !used[slot];
+            used[slot] = true;
+        }
+        if (ok) return seed;
+    }
+    return kNoSeed;
+}
+
+constexpr uint32_t kSeed = findSeed();
+static_assert(kCommandCount < kSlots, "too many commands, enlarge kSlots");
+static_assert(kSeed != kNoSeed, "no collision-free seed for command table, enlarge kSlots");
+
+// 槽 -> 命令下标（-1 表示空槽）
+constexpr std::array<int8_t, kSlots> buildSlots() {
+    std::array<int8_t, kSlots> slots{};
+    for (auto& s : slots) s = -1;
+    for (size_t i = 0; i < kCommandCount; ++i) {
+        slots[hashName(CommandTable::kCommands[i].name, kSeed) % kSlots] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+constexpr std::array<int8_t, kSlots> kSlotTable = buildSlots();
+}
+
+const MessageHandler::Command* MessageHandler::findCommand(std::string_view name) {
+    int8_t idx = kSlotTable[hashName(name, kSeed) % kSlots];
+    if (idx < 0) return nullptr;
+    const Command& cmd = CommandTable::kCommands[idx];
+    return cmd.name == name ? &cmd : nullptr;
+}
+
+HandlerResult MessageHandler::handleRequest(Connection& c, const json& rep) {
     json resp;
     try {
-        json        rep = json::parse(line);
-        std::string cmd = rep.value("cmd", "");
+        const Command* cmd = findCommand(rep.value("cmd", ""));
 
         // ========= 鉴权 =========
-        // 未登录只能执行：login / register / reset_pass（找回密码）
-        if (!c.authed &&
-            cmd != "login" &&
-            cmd != "register" &&
-            cmd != "reset_pass") {
+        // 未登录只能执行 needAuth = false 的命令：login / register / reset_pass（找回密码）
+        if (!c.authed && (cmd == nullptr || cmd->needAuth)) {
             resp["ok"]  = false;
             resp["err"] = "please login first";
-            return resp.dump() + "\n";
+            return resp;
         }
 
-        // ========= login =========
-        if (cmd == "login") {
-            std::string mode = rep.value("mode", "password");
-
-            // 1) 用户名 + 密码登录
-            if (mode == "password") {
-                std::string user = rep.value("user", "");
-                std::string pass = rep.value("pass", "");
-
-                int uid = 0;
-                if (auth_.login(user, pass, uid)) {
-                    c.authed = true;
-                    c.userId = uid;
-                    c.name   = user;
-
-                    // 尝试进入 1 号房间
-                    auto& roomMgr = RoomManager::Instance();
-                    if (roomMgr.tryEnterRoom(1, MAX_ROOM_SIZE)) {
-                        c.roomId      = 1;
-                        resp["roomId"] = 1;
-                        resp["msg"]    = "login success";
-                    } else {
-                        c.roomId      = 0;  // 没有房间
-                        resp["roomId"] = 0;
-                        resp["msg"]    = "login success, but room 1 is full";
-                    }
-
-                    resp["ok"]  = true;
-                } else {
-                    resp["ok"]  = false;
-                    resp["msg"] = "wrong username or password";
-                }
-
-                return resp.dump() + "\n";
-            }
-
-            // 2) 手机 + 短信验证码登录
-            else if (mode == "sms") {
-                int         step  = rep.value("step", 1);
-                std::string phone = rep.value("phone", "");
-
-                // step = 1 : 发送验证码
-                if (step == 1) {
-                    SmsResult r = sms_.sendCode(phone);
-                    resp["ok"]  = r.ok;
-                    resp["msg"] = r.msg;
-                    return resp.dump() + "\n";
-                }
-
-                // step = 2 : 验证码 + 手机号登录
-                else if (step == 2) {
-                    std::string code = rep.value("code", "");
-
-                    // A. 校验验证码（Redis）
-                    SmsResult r = sms_.verifyCode(phone, code);
-                    if (!r.ok) {
-                        resp["ok"]  = false;
-                        resp["msg"] = r.msg;
-                        return resp.dump() + "\n";
-                    }
-
-                    // B.通过 AuthService 按 phone 找用户（内部会走本地缓存 + Redis + MySQL）
-                    int         uid      = 0;
-                    std::string username;
-                    if (!auth_.loginByPhone(phone, uid, username)) {
-                        resp["ok"]  = false;
-                        resp["msg"] = "phone not registered";
-                        return resp.dump() + "\n";
-                    }
-
-                    // C. 登录成功，更新会话
-                    c.authed = true;
-                    c.userId = uid;
-                    c.name   = username;
-
-                    // 尝试进入 1 号房间
-                    auto& roomMgr = RoomManager::Instance();
-                    if (roomMgr.tryEnterRoom(1, MAX_ROOM_SIZE)) {
-                        c.roomId      = 1;
-                        resp["roomId"] = 1;
-                        resp["msg"]    = "login success";
-                    } else {
-                        c.roomId      = 0;  // 没有房间
-                        resp["roomId"] = 0;
-                        resp["msg"]    = "login success, but room 1 is full";
-                    }
-
-                    resp["ok"]  = true;
-                    return resp.dump() + "\n";
-                }
-
-                // 其它 step 值非法
-                resp["ok"]  = false;
-                resp["msg"] = "invalid step for sms login";
-                return resp.dump() + "\n";
-            }
-
-            // 其它 mode 非法
+        if (cmd == nullptr) {
             resp["ok"]  = false;
-            resp["msg"] = "invalid login mode";
-            return resp.dump() + "\n";
+            resp["err"] = "unknown cmd";
+            return resp;
         }
 
-        // ========= register（带短信验证码） =========
-        else if (cmd == "register") {
-            int         step  = rep.value("step", 1);
-            std::string phone = rep.value("phone", "");
+        return (this->*(cmd->handle))(c, rep);
 
-            // step = 1 : 发送验证码
-            if (step == 1) {
-                SmsResult r = sms_.sendCode(phone);
-                resp["ok"]  = r.ok;
-                resp["msg"] = r.msg;
-                return resp.dump() + "\n";
-            }
+    } catch (const std::exception& e) {
+        resp["ok"]  = false;
+        resp["err"] = e.what();
+        return resp;
+    }
+}
 
-            // step = 2 : 校验验证码 + 用户名 + 两次密码
-            if (step == 2) {
-                std::string code  = rep.value("code", "");
-                std::string user  = rep.value("user", "");
-                std::string pass  = rep.value("pass", "");
-                std::string pass2 = rep.value("pass2", "");
-
-                // 1. 两次密码必须一致
-                if (pass != pass2) {
-                    resp["ok"]  = false;
-                    resp["msg"] = "two passwords not match";
-                    return resp.dump() + "\n";
-                }
-
-                // 2. 校验验证码
-                SmsResult r = sms_.verifyCode(phone, code);
-                if (!r.ok) {
-                    resp["ok"]  = false;
-                    resp["msg"] = r.msg;
-                    return resp.dump() + "\n";
-                }
-
-                // 3. 调 AuthService 注册
-                int uid = 0;
-                if (auth_.Register(phone, user, pass, uid)) {
-                    resp["ok"]     = true;
-                    resp["msg"]    = "register success";
-                    resp["userId"] = uid;
-                    resp["user"]   = user;
-                } else {
-                    resp["ok"]  = false;
-                    resp["msg"] = "register failed";
-                }
-                return resp.dump() + "\n";
+// ========= login =========
+HandlerResult MessageHandler::cmdLogin(Connection& c, const json& rep) {
+    json resp;
+    std::string mode = rep.value("mode", "password");
+
+    // 1) 用户名 + 密码登录
+    if (mode == "password") {
+        std::string user = rep.value("user", "");
+        std::string pass = rep.value("pass", "");
+
+        int uid = 0;
+        if (auth_.login(user, pass, uid)) {
+            c.name   = user;
+            c.userId = uid;
+            c.authed = true;   // 最后置位：loop 线程看到 authed 时 userId 已经写好
+
+            // 尝试进入 1 号房间
+            if (enterRoom(c, 1)) {
+                settleRoom(c, 1);
+                resp["roomId"] = 1;
+                resp["msg"]    = "login success";
+            } else {
+                settleRoom(c, 0);  // 没有房间
+                resp["roomId"] = 0;
+                resp["msg"]    = "login success, but room 1 is full";
             }
 
+            resp["ok"]  = true;
+        } else {
             resp["ok"]  = false;
-            resp["msg"] = "invalid step for register";
-            return resp.dump() + "\n";
+            resp["msg"] = "wrong username or password";
         }
 
-        // ========= update_name（改昵称，需要已登录） =========
-        else if (cmd == "update_name") {
-            // 必须已经登录，这里多判一次更安全
-            if (!c.authed || c.userId <= 0) {
-                resp["ok"]  = false;
-                resp["msg"] = "not authed";
-                return resp.dump() + "\n";
-            }
+        return resp;
+    }
 
-            std::string newName = rep.value("newName", "");
-            if (newName.empty()) {
+    // 2) 手机 + 短信验证码登录
+    else if (mode == "sms") {
+        int         step  = rep.value("step", 1);
+        std::string phone = rep.value("phone", "");
+
+        // step = 1 : 发送验证码
+        if (step == 1) {
+            SmsResult r = sms_.sendCode(phone);
+            resp["ok"]  = r.ok;
+            resp["msg"] = r.msg;
+            return resp;
+        }
+
+        // step = 2 : 验证码 + 手机号登录
+        else if (step == 2) {
+            std::string code = rep.value("code", "");
+
+            // A. 校验验证码（Redis）
+            SmsResult r = sms_.verifyCode(phone, code);
+            if (!r.ok) {
                 resp["ok"]  = false;
-                resp["msg"] = "newName cannot be empty";
-                return resp.dump() + "\n";
+                resp["msg"] = r.msg;
+                return resp;
             }
 
-            std::string oldName;
-            std::string phone;
-            // 这里的 userId 从 Connection 里拿，用户自己是不需要知道 id 的
-            if (auth_.updateUsername(c.userId, newName, oldName, phone)) {
-                c.name = newName;  // 更新会话中的名字
-
-                resp["ok"]       = true;
-                resp["msg"]      = "update username success";
-                resp["oldName"]  = oldName;
-                resp["newName"]  = newName;
-                resp["phone"]    = phone;
-            } else {
+            // B.通过 AuthService 按 phone 找用户（内部会走本地缓存 + Redis + MySQL）
+            int         uid      = 0;
+            std::string username;
+            if (!auth_.loginByPhone(phone, uid, username)) {
                 resp["ok"]  = false;
-                resp["msg"] = "update username failed";
+                resp["msg"] = "phone not registered";
+                return resp;
             }
-            return resp.dump() + "\n";
-        }
 
-        // ========= reset_pass（忘记密码：手机号 + 短信验证码） =========
-        else if (cmd == "reset_pass") {
-            int         step  = rep.value("step", 1);
-            std::string phone = rep.value("phone", "");
+            // C. 登录成功，更新会话
+            c.name   = username;
+            c.userId = uid;
+            c.authed = true;   // 最后置位：loop 线程看到 authed 时 userId 已经写好
 
-            // step = 1 : 发送验证码
-            if (step == 1) {
-                SmsResult r = sms_.sendCode(phone);
-                resp["ok"]  = r.ok;
-                resp["msg"] = r.msg;
-                return resp.dump() + "\n";
-            }
-
-            // step = 2 : 校验验证码 + 设置新密码
-            if (step == 2) {
-                std::string code    = rep.value("code", "");
-                std::string newPass = rep.value("newPass", "");
-
-                if (newPass.empty()) {
-                    resp["ok"]  = false;
-                    resp["msg"] = "newPass cannot be empty";
-                    return resp.dump() + "\n";
-                }
-
-                // 1. 校验验证码
-                SmsResult r = sms_.verifyCode(phone, code);
-                if (!r.ok) {
-                    resp["ok"]  = false;
-                    resp["msg"] = r.msg;
-                    return resp.dump() + "\n";
-                }
-
-                // 2. 更新数据库密码（并清理对应缓存）
-                if (auth_.resetPasswordByPhone(phone, newPass)) {
-                    resp["ok"]  = true;
-                    resp["msg"] = "reset password success";
-                } else {
-                    resp["ok"]  = false;
-                    resp["msg"] = "reset password failed";
-                }
-                return resp.dump() + "\n";
+            // 尝试进入 1 号房间
+            if (enterRoom(c, 1)) {
+                settleRoom(c, 1);
+                resp["roomId"] = 1;
+                resp["msg"]    = "login success";
+            } else {
+                settleRoom(c, 0);  // 没有房间
+                resp["roomId"] = 0;
+                resp["msg"]    = "login success, but room 1 is full";
             }
 
-            resp["ok"]  = false;
-            resp["msg"] = "invalid step for reset_pass";
-            return resp.dump() + "\n";
+            resp["ok"]  = true;
+            return resp;
         }
 
-        // 加入/切换房间（切换聊天室，带容量限制）
-        else if (cmd == "join_room") {
-            if (!c.authed || c.userId <= 0) {
-                resp["ok"]  = false;
-                resp["msg"] = "not authed";
-                return resp.dump() + "\n";
-            }
+        // 其它 step 值非法
+        resp["ok"]  = false;
+        resp["msg"] = "invalid step for sms login";
+        return resp;
+    }
 
-            int newRoomId = rep.value("roomId", 1);
-            if (newRoomId <= 0) newRoomId = 1;
+    // 其它 mode 非法
+    resp["ok"]  = false;
+    resp["msg"] = "invalid login mode";
+    return resp;
+}
 
-            int oldRoomId = c.roomId;
-            if (newRoomId == oldRoomId) {
-                // 已经在这个房间了
-                resp["ok"]     = true;
-                resp["roomId"] = newRoomId;
-                resp["msg"]    = "already in this room";
-                return resp.dump() + "\n";
-            }
+// ========= register（带短信验证码） =========
+HandlerResult MessageHandler::cmdRegister(Connection& /*c*/, const json& rep) {
+    json resp;
+    int         step  = rep.value("step", 1);
+    std::string phone = rep.value("phone", "");
+
+    // step = 1 : 发送验证码
+    if (step == 1) {
+        SmsResult r = sms_.sendCode(phone);
+        resp["ok"]  = r.ok;
+        resp["msg"] = r.msg;
+        return resp;
+    }
 
-            auto& roomMgr = RoomManager::Instance();
-            if (!roomMgr.tryEnterRoom(newRoomId, MAX_ROOM_SIZE)) {
-                resp["ok"]     = false;
-                resp["msg"]    = "room is full";
-                resp["roomId"] = oldRoomId; // 保持原房间不变
-                return resp.dump() + "\n";
-            }
+    // step = 2 : 校验验证码 + 用户名 + 两次密码
+    if (step == 2) {
+        std::string code  = rep.value("code", "");
+        std::string user  = rep.value("user", "");
+        std::string pass  = rep.value("pass", "");
+        std::string pass2 = rep.value("pass2", "");
 
-            // 成功进入新房间后，再从旧房间退出（如果旧房间有效）
-            if (oldRoomId > 0) {
-                roomMgr.leaveRoom(oldRoomId);
-            }
+        // 1. 两次密码必须一致
+        if (pass != pass2) {
+            resp["ok"]  = false;
+            resp["msg"] = "two passwords not match";
+            return resp;
+        }
 
-            c.roomId       = newRoomId;
+        // 2. 校验验证码
+        SmsResult r = sms_.verifyCode(phone, code);
+        if (!r.ok) {
+            resp["ok"]  = false;
+            resp["msg"] = r.msg;
+            return resp;
+        }
+
+        // 3. 调 AuthService 注册
+        int uid = 0;
+        if (auth_.Register(phone, user, pass, uid)) {
             resp["ok"]     = true;
-            resp["roomId"] = newRoomId;
-            resp["msg"]    = "join room success";
-            return resp.dump() + "\n";
+            resp["msg"]    = "register success";
+            resp["userId"] = uid;
+            resp["user"]   = user;
+        } else {
+            resp["ok"]  = false;
+            resp["msg"] = "register failed";
         }
+        return resp;
+    }
 
-        // 发送消息
-        else if (cmd == "send_msg") {
-            if (!c.authed || c.userId <= 0) {
-                resp["ok"]  = false;
-                resp["msg"] = "not authed";
-                return resp.dump() + "\n";
-            }
+    resp["ok"]  = false;
+    resp["msg"] = "invalid step for register";
+    return resp;
+}
 
-            std::string text = rep.value("text", "");
-            if (text.empty()) {
-                resp["ok"]  = false;
-                resp["msg"] = "text cannot be empty";
-                return resp.dump() + "\n";
-            }
+// ========= update_name（改昵称，需要已登录） =========
+HandlerResult MessageHandler::cmdUpdateName(Connection& c, const json& rep) {
+    json resp;
+    // 必须已经登录，这里多判一次更安全
+    if (!c.authed || c.userId <= 0) {
+        resp["ok"]  = false;
+        resp["msg"] = "not authed";
+        return resp;
+    }
 
-            int roomId = c.roomId;
-            if (roomId <= 0) roomId = 1;
-
-            // 这里先只做内存广播 + 回包，不做 DB 持久化，后面加历史消息 + 缓存
-            resp["ok"]        = true;
-            resp["broadcast"] = true;      // 关键！告诉 Server：这是广播消息
-            resp["roomId"]    = roomId;
-            resp["fromId"]    = c.userId;
-            resp["fromName"]  = c.name;
-            resp["text"]      = text;
-
-            // 简单时间戳（秒），客户端要精确再说
-            resp["ts"] = static_cast<long long>(
-                std::chrono::system_clock::to_time_t(
-                    std::chrono::system_clock::now()
-                )
-            );
-
-            return resp.dump() + "\n";
-        }
+    std::string newName = rep.value("newName", "");
+    if (newName.empty()) {
+        resp["ok"]  = false;
+        resp["msg"] = "newName cannot be empty";
+        return resp;
+    }
 
-        // 拉取历史消息（带 Redis 缓存 + 防缓存击穿）
-        else if (cmd == "get_history") {
-            if (!c.authed || c.userId <= 0) {
-                resp["ok"]  = false;
-                resp["msg"] = "not authed";
-                return resp.dump() + "\n";
-        }
+    std::string oldName;
+    std::string phone;
+    // 这里的 userId 从 Connection 里拿，用户自己是不需要知道 id 的
+    if (auth_.updateUsername(c.userId, newName, oldName, phone)) {
+        c.name = newName;  // 更新会话中的名字
+
+        resp["ok"]       = true;
+        resp["msg"]      = "update username success";
+        resp["oldName"]  = oldName;
+        resp["newName"]  = newName;
+        resp["phone"]    = phone;
+    } else {
+        resp["ok"]  = false;
+        resp["msg"] = "update username failed";
+    }
+    return resp;
+}
+
+// ========= reset_pass（忘记密码：手机号 + 短信验证码） =========
+HandlerResult MessageHandler::cmdResetPass(Connection& /*c*/, const json& rep) {
+    json resp;
+    int         step  = rep.value("step", 1);
+    std::string phone = rep.value("phone", "");
+
+    // step = 1 : 发送验证码
+    if (step == 1) {
+        SmsResult r = sms_.sendCode(phone);
+        resp["ok"]  = r.ok;
+        resp["msg"] = r.msg;
+        return resp;
+    }
+
+    // step = 2 : 校验验证码 + 设置新密码
+    if (step == 2) {
+        std::string code    = rep.value("code", "");
+        std::string newPass = rep.value("newPass", "");
 
-        int roomId = c.roomId;
-        if (roomId <= 0) {
+        if (newPass.empty()) {
             resp["ok"]  = false;
-            resp["msg"] = "not in any room";
-            return resp.dump() + "\n";
+            resp["msg"] = "newPass cannot be empty";
+            return resp;
         }
 
-        int limit = rep.value("limit", 10);
-        if (limit <= 0) {
+        // 1. 校验验证码
+        SmsResult r = sms_.verifyCode(phone, code);
+        if (!r.ok) {
             resp["ok"]  = false;
-            resp["msg"] = "invalid limit";
-            return resp.dump() + "\n";
+            resp["msg"] = r.msg;
+            return resp;
         }
 
-            json history;
-        if (!chat::GetHistoryWithCache(roomId, limit, history)) {
+        // 2. 更新数据库密码（并清理对应缓存）
+        if (auth_.resetPasswordByPhone(phone, newPass)) {
+            resp["ok"]  = true;
+            resp["msg"] = "reset password success";
+        } else {
             resp["ok"]  = false;
-            resp["msg"] = "get history failed";
-            return resp.dump() + "\n";
+            resp["msg"] = "reset password failed";
         }
+        return resp;
+    }
 
-        resp["ok"]      = true;
-        resp["roomId"]  = roomId;
-        resp["history"] = history;
-        return resp.dump() + "\n";
-        }
+    resp["ok"]  = false;
+    resp["msg"] = "invalid step for reset_pass";
+    return resp;
+}
 
+// 加入/切换房间（切换聊天室，带容量限制）
+HandlerResult MessageHandler::cmdJoinRoom(Connection& c, const json& rep) {
+    json resp;
+    if (!c.authed || c.userId <= 0) {
+        resp["ok"]  = false;
+        resp["msg"] = "not authed";
+        return resp;
+    }
 
-        // ========= echo =========
-        else if (cmd == "echo") {
-            std::string msg = rep.value("msg", "");
-            resp["ok"]   = true;
-            resp["data"] = msg;
-            return resp.dump() + "\n";
-        }
+    int newRoomId = rep.value("roomId", 1);
+    if (newRoomId <= 0) newRoomId = 1;
 
-        // ========= upper =========
-        else if (cmd == "upper") {
-            std::string msg = rep.value("msg", "");
-            for (auto& ch : msg) {
-                ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
-            }
-            resp["ok"]   = true;
-            resp["data"] = msg;
-            return resp.dump() + "\n";
-        }
+    int oldRoomId = c.roomId;
+    if (newRoomId == oldRoomId) {
+        // 已经在这个房间了
+        resp["ok"]     = true;
+        resp["roomId"] = newRoomId;
+        resp["msg"]    = "already in this room";
+        return resp;
+    }
 
-        // ========= quit =========
-        else if (cmd == "quit") {
-            resp["ok"]    = true;
-            resp["data"]  = "bye";
-            resp["close"] = true;
-            return resp.dump() + "\n";
-        }
+    if (!enterRoom(c, newRoomId)) {
+        resp["ok"]     = false;
+        resp["msg"]    = "room is full";
+        resp["roomId"] = oldRoomId; // 保持原房间不变
+        return resp;
+    }
 
-        else {
-            resp["ok"]  = false;
-            resp["err"] = "unknown cmd";
-            return resp.dump() + "\n";
-        }
+    // 成功进入新房间后，再从旧房间退出（如果旧房间有效）
+    if (oldRoomId > 0) {
+        RoomManager::Instance().leaveRoom(oldRoomId, memberOf(c));
+    }
 
-    } catch (const std::exception& e) {
+    settleRoom(c, newRoomId);
+    resp["ok"]     = true;
+    resp["roomId"] = newRoomId;
+    resp["msg"]    = "join room success";
+    return resp;
+}
+
+// 发送消息
+HandlerResult MessageHandler::cmdSendMsg(Connection& c, const json& rep) {
+    json resp;
+    if (!c.authed || c.userId <= 0) {
         resp["ok"]  = false;
-        resp["err"] = e.what();
-        return resp.dump() + "\n";
+        resp["msg"] = "not authed";
+        return resp;
+    }
+
+    std::string text = rep.value("text", "");
+    if (text.empty()) {
+        resp["ok"]  = false;
+        resp["msg"] = "text cannot be empty";
+        return resp;
+    }
+
+    int roomId = c.roomId;
+    if (roomId <= 0) roomId = 1;
+
+    resp["ok"]        = true;
+    resp["broadcast"] = true;      // 给客户端区分广播和普通回包用，Server 看的是返回的 route
+    resp["roomId"]    = roomId;
+    resp["fromId"]    = c.userId.load();
+    resp["fromName"]  = c.name;
+    resp["text"]      = text;
+
+    // 简单时间戳（秒），客户端要精确再说
+    long long ts = static_cast<long long>(
+        std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now()
+        )
+    );
+    resp["ts"] = ts;
+
+    // 消息 id 在进程内分配，广播里带上，客户端翻历史时可以拿它当游标
+    int64_t id = chat::NextMessageId();
+    resp["id"] = id;
+
+    // 进房间的内存环（get_history 马上能看到）+ 异步落库：攒批写 DB 由 MessageWriter 的写线程做，
+    // 队列满了这条不落库，广播照发
+    chat::SaveMessage(id, roomId, c.userId, c.name, text, ts);
+
+    return HandlerResult::broadcast(roomId, std::move(resp));
+}
+
+// 拉取历史消息（房间内存环，冷房间第一次读时从 DB 填）
+// 带 before_id 往前翻页、带 after_id 往后追（环外面的老消息走 Redis 页缓存 + DB keyset 查询），
+// 回包里的 nextBeforeId / nextAfterId 是下一页的游标
+HandlerResult MessageHandler::cmdGetHistory(Connection& c, const json& rep) {
+    json resp;
+    if (!c.authed || c.userId <= 0) {
+        resp["ok"]  = false;
+        resp["msg"] = "not authed";
+        return resp;
+    }
+
+    int roomId = c.roomId;
+    if (roomId <= 0) {
+        resp["ok"]  = false;
+        resp["msg"] = "not in any room";
+        return resp;
+    }
+
+    int limit = rep.value("limit", 10);
+    if (limit <= 0) {
+        resp["ok"]  = false;
+        resp["msg"] = "invalid limit";
+        return resp;
+    }
+
+    int64_t beforeId = rep.value("before_id", 0LL);
+    int64_t afterId  = rep.value("after_id", 0LL);
+    if (beforeId < 0 || afterId < 0 || (beforeId > 0 && afterId > 0)) {
+        resp["ok"]  = false;
+        resp["msg"] = "invalid cursor";
+        return resp;
+    }
+
+    json history;
+    if (!chat::GetHistoryPage(roomId, limit, beforeId, afterId, history)) {
+        resp["ok"]  = false;
+        resp["msg"] = "get history failed";
+        return resp;
+    }
+
+    resp["ok"]      = true;
+    resp["roomId"]  = roomId;
+    if (!history.empty()) {
+        // 最新在前：最后一条是这一页最老的，第一条是最新的
+        resp["nextBeforeId"] = history.back().value("id", 0LL);
+        resp["nextAfterId"]  = history.front().value("id", 0LL);
     }
+    resp["history"] = std::move(history);
+    return resp;
+}
+
+// ========= echo =========
+HandlerResult MessageHandler::cmdEcho(Connection& /*c*/, const json& rep) {
+    json resp;
+    std::string msg = rep.value("msg", "");
+    resp["ok"]   = true;
+    resp["data"] = msg;
+    return resp;
+}
+
+// ========= ping =========
+// 最简单的 {"cmd":"ping"} 在 reactor 线程里就回掉了，走到这里的是带了别的字段的心跳：原样带回 seq / ts
+HandlerResult MessageHandler::cmdPing(Connection& /*c*/, const json& rep) {
+    json resp;
+    resp["ok"]  = true;
+    resp["cmd"] = "pong";
+    if (rep.contains("seq")) resp["seq"] = rep["seq"];
+    if (rep.contains("ts"))  resp["ts"]  = rep["ts"];
+    return resp;
+}
+
+// ========= upper =========
+HandlerResult MessageHandler::cmdUpper(Connection& /*c*/, const json& rep) {
+    json resp;
+    std::string msg = rep.value("msg", "");
+    for (auto& ch : msg) {
+        ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    }
+    resp["ok"]   = true;
+    resp["data"] = msg;
+    return resp;
+}
+
+// ========= quit =========
+HandlerResult MessageHandler::cmdQuit(Connection& /*c*/, const json& /*rep*/) {
+    json resp;
+    resp["ok"]    = true;
+    resp["data"]  = "bye";
+    resp["close"] = true;
+    return HandlerResult::closeAfter(std::move(resp));
 }
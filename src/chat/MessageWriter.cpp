@@ -0,0 +1,247 @@
+#include "chat/MessageWriter.h"
+#include "db/DBpool.h"
+#include "core/Logger.h"
+#include <limits>
+
+namespace chat {
+
+namespace {
+// 写线程空等多久看一眼是不是该退出了
+constexpr auto kIdleWait = std::chrono::milliseconds(100);
+// 一行除了正文以外在执行包里大概占多少字节（几个整数参数 + 长度前缀）
+constexpr size_t kRowOverhead = 64;
+// 一条预处理 INSERT 最多几行；没攒满的批按 2 的幂拆成几条执行（比如 300 = 256 + 32 + 8 + 4），
+// 每个连接上最多缓存 10 条不同行数的语句，不会每个批次大小都 prepare 一次。
+// 忙的时候批次都是攒满的，正好一条语句一次往返
+constexpr size_t kMaxStmtRows = MessageWriter::kMaxBatchRows;
+static_assert((kMaxStmtRows & (kMaxStmtRows - 1)) == 0, "kMaxBatchRows must be a power of two");
+constexpr unsigned kParamsPerRow = 6;
+
+// n 行的 INSERT：id 是进程内分配的，不用 DB 自增；created_at 用发送时间，排队晚写入也不会把历史顺序搞乱
+const std::string& insertSql(size_t rows) {
+    static const std::vector<std::string> texts = [] {
+        std::vector<std::string> v(kMaxStmtRows + 1);
+        for (size_t n = 1; n <= kMaxStmtRows; n *= 2) {
+            std::string sql =
+                "INSERT INTO messages(id, room_id, user_id, username, content, created_at) VALUES";
+            for (size_t i = 0; i < n; ++i) sql += i == 0 ? "(?,?,?,?,?,FROM_UNIXTIME(?))"
+                                                         : ",(?,?,?,?,?,FROM_UNIXTIME(?))";
+            v[n] = std::move(sql);
+        }
+        return v;
+    }();
+    return texts[rows];
+}
+
+// 剩下 rest 行时这一条 INSERT 写几行：不超过 rest 和 kMaxStmtRows 的最大的 2 的幂
+size_t chunkRows(size_t rest) {
+    size_t n = 1;
+    while (n * 2 <= rest && n * 2 <= kMaxStmtRows) n *= 2;
+    return n;
+}
+}
+
+MessageWriter& MessageWriter::Instance() {
+    static MessageWriter instance;
+    return instance;
+}
+
+MessageWriter::~MessageWriter() { stop(); }
+
+bool MessageWriter::start(size_t writerThreads, size_t queueCapacity) {
+    if (running_.load()) {
+        LOG_INFO("[MessageWriter::start] already running");
+        return true;
+    }
+    if (writerThreads == 0) writerThreads = 1;
+
+    // 队列先建好再放开 enqueue（running_ 的 release 保证业务线程看得到 queue_）
+    queue_ = std::make_unique<BoundedQueue<PendingMessage>>(queueCapacity);
+    running_.store(true, std::memory_order_release);
+    for (size_t i = 0; i < writerThreads; ++i) {
+        writers_.emplace_back([this, i]() { writerLoop(i); });
+    }
+    LOG_INFO("[MessageWriter::start] writers=" << writerThreads
+             << " queueCapacity=" << queue_->capacity());
+    return true;
+}
+
+void MessageWriter::stop() {
+    if (!running_.exchange(false)) return;
+
+    LOG_INFO("[MessageWriter::stop] flushing " << queue_->sizeApprox() << " queued messages");
+    // 写线程看到 running_ 变 false 以后会把队列写空再退出
+    for (auto& th : writers_) {
+        if (th.joinable()) th.join();
+    }
+    writers_.clear();
+
+    // 退出前最后一刻才挤进来的几条，在这里补写
+    std::vector<PendingMessage> batch;
+    while (collectBatch(batch, Clock::duration::zero())) {
+        flushBatch(batch);
+        batch.clear();
+    }
+
+    Stats st = stats();
+    LOG_INFO("[MessageWriter::stop] stopped, written=" << st.written << " batches=" << st.batches
+             << " dropped=" << st.dropped << " late=" << st.late);
+}
+
+bool MessageWriter::enqueue(int64_t id, int roomId, int userId, std::string username,
+                            std::string text, int64_t ts) {
+    if (!running_.load(std::memory_order_acquire)) {
+        countDropped(1, "writer not running");
+        return false;
+    }
+
+    PendingMessage msg;
+    msg.id         = id;
+    msg.roomId     = roomId;
+    msg.userId     = userId;
+    msg.username   = std::move(username);
+    msg.text       = std::move(text);
+    msg.ts         = ts;
+    msg.enqueuedAt = Clock::now();
+    // 先登记再入队：写线程拿到它的时候一定已经登记过了
+    markPending(roomId, id);
+    if (!queue_->tryPush(std::move(msg))) {
+        unmarkPending(roomId, id);
+        countDropped(1, "queue full");
+        return false;
+    }
+    return true;
+}
+
+int64_t MessageWriter::durableBelow(int roomId) const {
+    PendingShard& sh = pendingShardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    auto it = sh.rooms.find(roomId);
+    if (it == sh.rooms.end()) return std::numeric_limits<int64_t>::max();
+    return *it->second.begin();
+}
+
+void MessageWriter::markPending(int roomId, int64_t id) {
+    PendingShard& sh = pendingShardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    sh.rooms[roomId].insert(id);
+}
+
+void MessageWriter::unmarkPending(int roomId, int64_t id) {
+    PendingShard& sh = pendingShardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    auto it = sh.rooms.find(roomId);
+    if (it == sh.rooms.end()) return;
+    auto pos = it->second.find(id);
+    if (pos != it->second.end()) it->second.erase(pos);
+    if (it->second.empty()) sh.rooms.erase(it);
+}
+
+MessageWriter::Stats MessageWriter::stats() const {
+    Stats st;
+    st.queued  = queue_ ? queue_->sizeApprox() : 0;
+    st.written = written_.load(std::memory_order_relaxed);
+    st.batches = batches_.load(std::memory_order_relaxed);
+    st.dropped = dropped_.load(std::memory_order_relaxed);
+    st.late    = late_.load(std::memory_order_relaxed);
+    return st;
+}
+
+void MessageWriter::writerLoop(size_t index) {
+    LOG_INFO("[MessageWriter::writerLoop] writer " << index << " start");
+    std::vector<PendingMessage> batch;
+    batch.reserve(kMaxBatchRows);
+
+    for (;;) {
+        if (collectBatch(batch, kIdleWait)) {
+            flushBatch(batch);
+            batch.clear();
+            continue;
+        }
+        // 停止之后也要把队列写空才退出
+        if (!running_.load(std::memory_order_acquire) && queue_->sizeApprox() == 0) break;
+    }
+    LOG_INFO("[MessageWriter::writerLoop] writer " << index << " exit");
+}
+
+bool MessageWriter::collectBatch(std::vector<PendingMessage>& batch, Clock::duration waitFor) {
+    PendingMessage msg;
+    if (!queue_->popFor(msg, waitFor)) return false;
+
+    // 第一条到手之后最多再等 kFlushDelayMs：消息少的时候延迟低，多的时候一批能攒满
+    auto deadline = Clock::now() + std::chrono::milliseconds(kFlushDelayMs);
+    size_t bytes = 0;
+    for (;;) {
+        bytes += msg.username.size() + msg.text.size() + kRowOverhead;
+        batch.push_back(std::move(msg));
+        if (batch.size() >= kMaxBatchRows || bytes >= kMaxBatchBytes) break;
+        if (queue_->tryPop(msg)) continue;
+        if (!queue_->popUntil(msg, deadline)) break;
+    }
+    return true;
+}
+
+void MessageWriter::flushBatch(std::vector<PendingMessage>& batch) {
+    // 一批拆成几条 INSERT 执行；done 之前的已经写进去了，重试只写剩下的
+    size_t done = 0;
+    for (int attempt = 0; attempt <= kMaxRetries && done < batch.size(); ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100 * attempt));
+        }
+        auto dbConn = DBPool::Instance().getConnection();
+        if (!dbConn) {
+            LOG_ERROR("[MessageWriter::flushBatch] no db connection, attempt=" << attempt);
+            continue;
+        }
+
+        while (done < batch.size()) {
+            size_t n = chunkRows(batch.size() - done);
+            PreparedStatement* stmt = dbConn->prepare(insertSql(n));
+            if (!stmt) break;
+
+            for (size_t r = 0; r < n; ++r) {
+                const PendingMessage& m = batch[done + r];
+                unsigned base = static_cast<unsigned>(r) * kParamsPerRow;
+                stmt->bindInt(base, m.id);
+                stmt->bindInt(base + 1, m.roomId);
+                stmt->bindInt(base + 2, m.userId);
+                stmt->bindString(base + 3, m.username);
+                stmt->bindString(base + 4, m.text);
+                stmt->bindInt(base + 5, m.ts);
+            }
+            if (!stmt->execute()) {
+                LOG_ERROR("[MessageWriter::flushBatch] insert " << n << " rows failed, "
+                          << batch.size() - done << " left, attempt=" << attempt);
+                break;
+            }
+            done += n;
+        }
+    }
+
+    if (done > 0) {
+        auto now = Clock::now();
+        uint64_t late = 0;
+        for (size_t i = 0; i < done; ++i) {
+            if (now - batch[i].enqueuedAt > std::chrono::milliseconds(kLateMs)) ++late;
+        }
+        written_.fetch_add(done, std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        if (late > 0) late_.fetch_add(late, std::memory_order_relaxed);
+        LOGF_DEBUG("[MessageWriter::flushBatch] inserted {} rows ({} late)", done, late);
+    }
+    if (done < batch.size()) countDropped(batch.size() - done, "insert failed");
+    // 写进去的和丢掉的都不会再变了
+    for (const PendingMessage& m : batch) unmarkPending(m.roomId, m.id);
+}
+
+void MessageWriter::countDropped(size_t n, const char* reason) {
+    uint64_t before = dropped_.fetch_add(n, std::memory_order_relaxed);
+    uint64_t after  = before + n;
+    // 累计数跨过 1、2、4、8... 时打一条，DB 挂掉的时候别把日志也打爆
+    if ((before ^ after) > before) {
+        LOG_WARN("[MessageWriter] dropped " << n << " messages (" << reason
+                 << "), total dropped=" << after);
+    }
+}
+
+}
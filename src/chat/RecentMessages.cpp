@@ -0,0 +1,135 @@
+#include "chat/RecentMessages.h"
+#include <algorithm>
+#include <limits>
+
+namespace chat {
+
+namespace {
+int64_t idOf(const json& item) { return item.value("id", 0LL); }
+}
+
+RecentMessages& RecentMessages::Instance() {
+    static RecentMessages inst;
+    return inst;
+}
+
+void RecentMessages::Ring::push(json item) {
+    if (items.size() < kCapacity) {
+        items.push_back(std::move(item));
+    } else {
+        // 满了：覆盖最老的一条，环外面从此有了更老的消息
+        items[head] = std::move(item);
+        head = (head + 1) % items.size();
+        complete = false;
+    }
+
+    // id 分配和 append 不在同一把锁里，同一房间并发发消息时可能差一两个位置，
+    // 往前冒泡保持环里按 id 有序（游标翻页靠这个）
+    for (size_t i = 0; i + 1 < items.size(); ++i) {
+        int64_t cur = idOf(newest(i)), prev = idOf(newest(i + 1));
+        if (cur == 0 || prev == 0 || prev < cur) break;
+        std::swap(newest(i), newest(i + 1));
+    }
+}
+
+RecentMessages::Ring& RecentMessages::touch(Shard& sh, int roomId) {
+    auto it = sh.rooms.find(roomId);
+    if (it == sh.rooms.end()) {
+        if (sh.rooms.size() >= kMaxRoomsPerShard) {
+            // 分片里最多几百个房间，线性扫一遍就行；只在新房间进来时才做
+            auto victim = std::min_element(sh.rooms.begin(), sh.rooms.end(),
+                                           [](const auto& a, const auto& b) {
+                                               return a.second.lastUsed < b.second.lastUsed;
+                                           });
+            sh.rooms.erase(victim);
+        }
+        it = sh.rooms.emplace(roomId, Ring{}).first;
+    }
+    it->second.lastUsed = ++sh.tick;
+    return it->second;
+}
+
+bool RecentMessages::get(int roomId, int limit, json& out) {
+    return getPage(roomId, limit, 0, 0, out);
+}
+
+bool RecentMessages::getPage(int roomId, int limit, int64_t beforeId, int64_t afterId,
+                             json& out) {
+    Shard& sh = shardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    auto it = sh.rooms.find(roomId);
+    if (it == sh.rooms.end() || !it->second.warmed) return false;
+
+    const Ring& ring = it->second;
+    it->second.lastUsed = ++sh.tick;
+    size_t want = static_cast<size_t>(std::max(limit, 0));
+    out = json::array();
+
+    if (afterId > 0) {
+        // 环里最老的一条都比游标新：中间可能还有被挤出环的消息，只能查 DB
+        if (!ring.complete && (ring.size() == 0 || idOf(ring.newest(ring.size() - 1)) > afterId)) {
+            return false;
+        }
+        // 从老往新取紧跟在游标后面的 want 条，再翻成最新在前
+        for (size_t i = ring.size(); i-- > 0 && out.size() < want;) {
+            if (idOf(ring.newest(i)) > afterId) out.push_back(ring.newest(i));
+        }
+        std::reverse(out.begin(), out.end());
+        return true;
+    }
+
+    for (size_t i = 0; i < ring.size() && out.size() < want; ++i) {
+        // 游标页不带 id 为 0 的（缺 id 字段的旧条目，不知道排在哪）
+        int64_t id = idOf(ring.newest(i));
+        if (beforeId > 0 && (id == 0 || id >= beforeId)) continue;
+        out.push_back(ring.newest(i));
+    }
+    // 凑不满一页：要么房间确实就这么多，要么剩下的在环外面
+    return beforeId <= 0 || out.size() >= want || ring.complete;
+}
+
+bool RecentMessages::warm(int roomId, const json& newestFirst, int64_t durableBelow) {
+    Shard& sh = shardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    Ring& ring = touch(sh, roomId);
+    if (ring.warmed) return true;
+
+    // 还没落库的消息（id >= durableBelow）DB 里查不到，只能靠环里 warm 之前 append 的那些补上；
+    // 环里最老的一条比它们新，说明有一部分跟着被淘汰的环一起没了，这时 warm 出来的环会有空洞
+    if (durableBelow != std::numeric_limits<int64_t>::max()) {
+        int64_t oldest = ring.size() > 0 ? idOf(ring.newest(ring.size() - 1)) : 0;
+        if (ring.size() == 0 || oldest == 0 || oldest > durableBelow) return false;
+    }
+
+    // DB 里的 + warm 之前 append 进来的（可能还没落库），按 id 从新到旧合并去重
+    std::vector<json> merged;
+    merged.reserve(newestFirst.size() + ring.size());
+    for (const auto& item : newestFirst) merged.push_back(item);
+    for (size_t i = 0; i < ring.size(); ++i) merged.push_back(ring.newest(i));
+
+    std::stable_sort(merged.begin(), merged.end(),
+                     [&](const json& a, const json& b) { return idOf(a) > idOf(b); });
+    merged.erase(std::unique(merged.begin(), merged.end(),
+                             [&](const json& a, const json& b) {
+                                 return idOf(a) != 0 && idOf(a) == idOf(b);
+                             }),
+                 merged.end());
+    // DB 里连一环都不满，说明整个房间的消息都在这里了
+    ring.complete = newestFirst.size() < kCapacity && merged.size() <= kCapacity;
+    if (merged.size() > kCapacity) merged.resize(kCapacity);
+
+    // 重新按从旧到新放好
+    ring.items.clear();
+    ring.head = 0;
+    for (auto it = merged.rbegin(); it != merged.rend(); ++it) ring.items.push_back(std::move(*it));
+    ring.warmed = true;
+    return true;
+}
+
+void RecentMessages::append(int roomId, json item) {
+    Shard& sh = shardOf(roomId);
+    std::lock_guard<std::mutex> lock(sh.mtx);
+    touch(sh, roomId).push(std::move(item));
+}
+
+}
@@ -0,0 +1,43 @@
+#include "core/Buffer.h"
+#include <sys/uio.h>
+#include <errno.h>
+
+ssize_t Buffer::readFd(int fd, int* savedErrno) {
+    // 栈上的备用空间：缓冲区剩余空间不够时，多出来的先读到这里，再 append 回来
+    char extrabuf[65536];
+
+    struct iovec vec[2];
+    const size_t writable = writableBytes();
+    vec[0].iov_base = beginWrite();
+    vec[0].iov_len  = writable;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len  = sizeof(extrabuf);
+
+    // 缓冲区本身已经够大（>= 64KB）时就不用 extrabuf 了
+    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else if (static_cast<size_t>(n) <= writable) {
+        writerIndex_ += static_cast<size_t>(n);
+    } else {
+        writerIndex_ = buffer_.size();
+        append(extrabuf, static_cast<size_t>(n) - writable);
+    }
+    return n;
+}
+
+void Buffer::makeSpace(size_t len) {
+    if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
+        // 头部空出来的 + 尾部剩下的都不够，只能扩容
+        buffer_.resize(writerIndex_ + len);
+    } else {
+        // 把可读数据整体挪回 kCheapPrepend 处，复用前面已经被取走的空间
+        const size_t readable = readableBytes();
+        std::copy(begin() + readerIndex_,
+                  begin() + writerIndex_,
+                  begin() + kCheapPrepend);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
+    }
+}
@@ -0,0 +1,162 @@
+#include "core/ListenerHandoff.h"
+#include "core/Logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstring>
+
+namespace handoff {
+
+namespace {
+// 随 fd 一起发的 4 字节：魔数 + 端口（大端），新进程核对端口，防止接错服务
+constexpr char kMagic[2] = {'N', 'H'};
+constexpr char kAck      = 'K';
+
+bool fillAddr(const std::string& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("[handoff] bad control socket path: " << path);
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+void setTimeouts(int fd, int timeoutMs) {
+    timeval tv{};
+    tv.tv_sec  = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+}
+
+int receiveListener(const std::string& path, uint16_t port, int timeoutMs) {
+    sockaddr_un addr;
+    if (!fillAddr(path, addr)) return -1;
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        LOG_ERROR("[handoff::receiveListener] socket failed: " << strerror(errno));
+        return -1;
+    }
+    if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        // 没有旧进程在跑（或者是残留的文件），正常情况
+        LOG_INFO("[handoff::receiveListener] no running server at " << path
+                 << " (" << strerror(errno) << "), bind a new listener");
+        ::close(sock);
+        return -1;
+    }
+    setTimeouts(sock, timeoutMs);
+
+    char data[4];
+    iovec iov{data, sizeof(data)};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ssize_t n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    int fd = -1;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&msg); n > 0 && c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&fd, CMSG_DATA(c), sizeof(int));
+        }
+    }
+
+    uint16_t gotPort = static_cast<uint16_t>((static_cast<uint8_t>(data[2]) << 8) |
+                                             static_cast<uint8_t>(data[3]));
+    if (n != static_cast<ssize_t>(sizeof(data)) || fd < 0 ||
+        data[0] != kMagic[0] || data[1] != kMagic[1] || gotPort != port) {
+        LOG_ERROR("[handoff::receiveListener] bad handoff from " << path << ", n=" << n
+                  << " fd=" << fd << " port=" << gotPort << " (want " << port << ")");
+        if (fd >= 0) ::close(fd);
+        ::close(sock);
+        return -1;
+    }
+
+    // 告诉旧进程收到了，它才会停止 accept
+    if (::write(sock, &kAck, 1) != 1) {
+        LOG_ERROR("[handoff::receiveListener] send ack failed: " << strerror(errno));
+        ::close(fd);
+        ::close(sock);
+        return -1;
+    }
+    ::close(sock);
+    LOG_INFO("[handoff::receiveListener] took over listen fd=" << fd << " (port "
+             << port << ") from " << path);
+    return fd;
+}
+
+int openControlSocket(const std::string& path) {
+    sockaddr_un addr;
+    if (!fillAddr(path, addr)) return -1;
+
+    int sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        LOG_ERROR("[handoff::openControlSocket] socket failed: " << strerror(errno));
+        return -1;
+    }
+    // 旧进程已经把监听 fd 交给我们了（或者是崩溃残留），这个路径现在归我们
+    ::unlink(path.c_str());
+    if (::bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(sock, 4) < 0) {
+        LOG_ERROR("[handoff::openControlSocket] bind/listen " << path << " failed: "
+                  << strerror(errno));
+        ::close(sock);
+        return -1;
+    }
+    LOG_INFO("[handoff::openControlSocket] listening for restarts on " << path);
+    return sock;
+}
+
+bool sendListener(int controlFd, int listenFd, uint16_t port) {
+    int sock = ::accept4(controlFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("[handoff::sendListener] accept failed: " << strerror(errno));
+        }
+        return false;
+    }
+    // 接到的是阻塞 socket：消息只有几个字节，等新进程回 ack 最多阻塞这么久
+    setTimeouts(sock, 3000);
+
+    char data[4] = {kMagic[0], kMagic[1], static_cast<char>(port >> 8),
+                    static_cast<char>(port & 0xff)};
+    iovec iov{data, sizeof(data)};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))];
+    std::memset(ctrl, 0, sizeof(ctrl));
+    msghdr msg{};
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type  = SCM_RIGHTS;
+    c->cmsg_len   = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(c), &listenFd, sizeof(int));
+
+    bool ok = false;
+    char ack = 0;
+    if (::sendmsg(sock, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(data))) {
+        LOG_ERROR("[handoff::sendListener] sendmsg failed: " << strerror(errno));
+    } else if (::read(sock, &ack, 1) != 1 || ack != kAck) {
+        // 新进程没确认（端口不对、中途退出了）：监听 fd 还是我们的，继续服务
+        LOG_ERROR("[handoff::sendListener] new process did not acknowledge the handoff");
+    } else {
+        ok = true;
+        LOG_INFO("[handoff::sendListener] listen fd=" << listenFd
+                 << " handed over to the new process");
+    }
+    ::close(sock);
+    return ok;
+}
+
+}
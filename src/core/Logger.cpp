@@ -0,0 +1,464 @@
+#include "core/Logger.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+/*一个线程的暂存缓冲区：字节环形队列，打日志的线程是唯一生产者，flusher 是唯一消费者。
+head / tail 都是一直递增的字节偏移，取模后才是下标，tail - head 就是已用字节数。*/
+struct LogThreadBuffer {
+    static constexpr size_t kCapacity = 256 * 1024;   // 必须是 2 的幂
+
+    std::unique_ptr<char[]> data{new char[kCapacity]};
+    alignas(64) std::atomic<uint64_t> head{0};   // flusher 推进
+    alignas(64) std::atomic<uint64_t> tail{0};   // 生产者推进
+    std::atomic<bool> retired{false};            // 线程已经退出，收完就可以丢掉
+
+    void copyIn(uint64_t pos, const void* src, size_t len) {
+        size_t off   = static_cast<size_t>(pos & (kCapacity - 1));
+        size_t first = std::min(len, kCapacity - off);
+        std::memcpy(data.get() + off, src, first);
+        std::memcpy(data.get(), static_cast<const char*>(src) + first, len - first);
+    }
+    void copyOut(uint64_t pos, void* dst, size_t len) const {
+        size_t off   = static_cast<size_t>(pos & (kCapacity - 1));
+        size_t first = std::min(len, kCapacity - off);
+        std::memcpy(dst, data.get() + off, first);
+        std::memcpy(static_cast<char*>(dst) + first, data.get(), len - first);
+    }
+};
+
+namespace {
+// 缓冲区里每条记录的头
+struct RecordHeader {
+    int64_t  sec;     // 产生时间（秒）
+    uint32_t len;     // 消息长度（结构化记录是参数编码的长度）
+    uint32_t fmtId;   // 结构化记录的格式串编号
+    uint8_t  level;
+    uint8_t  kind;    // 普通文本 / 结构化
+};
+
+// 单条消息上限，超过截断；保证一条记录一定放得进空缓冲区
+constexpr size_t kMaxMessage = LogThreadBuffer::kCapacity / 4;
+// 没人叫醒时 flusher 多久收一次
+constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+const char* levelToString(int lvl) {
+    switch (lvl) {
+        case 0: return "DEBUG";
+        case 1: return "INFO";
+        case 2: return "WARN";
+        case 3: return "ERROR";
+    }
+    return "INFO";
+}
+
+// 线程退出时只打个标记，缓冲区由 flusher 收完再释放
+struct LocalBufferHolder {
+    std::shared_ptr<LogThreadBuffer> buf;
+    ~LocalBufferHolder() {
+        if (buf) buf->retired.store(true, std::memory_order_release);
+    }
+};
+thread_local LocalBufferHolder t_local;
+
+template<class V>
+void appendRaw(std::string& out, V v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+}
+
+Logger::Logger(){
+    // 获取可执行文件所在绝对路径
+    std::string exePath = std::filesystem::canonical("/proc/self/exe").string();
+
+    // 得到可执行文件目录（/NebulaChat/build/）
+    auto exeDir = std::filesystem::path(exePath).parent_path();
+
+    // 得到项目根目录（/NebulaChat）
+    auto projectRoot = exeDir.parent_path();
+
+    auto logDir_ = projectRoot / "logs";
+
+    std::filesystem::create_directory(logDir_);
+
+    files_[static_cast<int>(LogLevel::DEBUG)].path = (logDir_ / "debug.log").string();
+    files_[static_cast<int>(LogLevel::INFO)].path  = (logDir_ / "info.log").string();
+    files_[static_cast<int>(LogLevel::WARN)].path  = (logDir_ / "warn.log").string();
+    files_[static_cast<int>(LogLevel::ERROR)].path = (logDir_ / "error.log").string();
+    for (auto& f : files_) openFile(f);
+    binFile_.path = (logDir_ / "nebula.blog").string();
+
+    if (const char* env = std::getenv("NEBULA_LOG_LEVEL")) {
+        std::string v(env);
+        if      (v == "debug") setLevel(LogLevel::DEBUG);
+        else if (v == "info")  setLevel(LogLevel::INFO);
+        else if (v == "warn")  setLevel(LogLevel::WARN);
+        else if (v == "error") setLevel(LogLevel::ERROR);
+    }
+    if (const char* env = std::getenv("NEBULA_LOG_FORMAT")) {
+        setBinaryOutput(std::string(env) == "binary");
+    }
+
+    flusher_ = std::thread([this] { flusherLoop(); });
+}
+
+Logger::~Logger(){
+    stop_.store(true);
+    {
+        std::lock_guard<std::mutex> lock(wakeMtx_);
+        wakeCv_.notify_one();
+    }
+    if (flusher_.joinable()) flusher_.join();
+
+    std::lock_guard<std::mutex> lock(directMtx_);
+    for (auto& f : files_) {
+        if (f.fd >= 0) ::close(f.fd);
+        f.fd = -1;
+    }
+    if (binFile_.fd >= 0) ::close(binFile_.fd);
+    binFile_.fd = -1;
+}
+
+LogThreadBuffer& Logger::localBuffer() {
+    if (!t_local.buf) {
+        t_local.buf = std::make_shared<LogThreadBuffer>();
+        std::lock_guard<std::mutex> lock(regMtx_);
+        buffers_.push_back(t_local.buf);
+    }
+    return *t_local.buf;
+}
+
+void Logger::log(LogLevel level, const char* msg, size_t len) {
+    append(level, kText, 0, msg, len);
+}
+
+uint32_t Logger::registerFormat(LogLevel level, const char* file, int line, const char* fmt) {
+    std::lock_guard<std::mutex> lock(fmtMtx_);
+    formats_.push_back(FormatInfo{level, file, line, fmt});
+    return static_cast<uint32_t>(formats_.size() - 1);
+}
+
+void Logger::append(LogLevel level, uint8_t kind, uint32_t fmtId, const char* msg, size_t len) {
+    if (stopped_.load(std::memory_order_acquire)) {
+        writeDirect(level, kind, fmtId, msg, len);
+        return;
+    }
+
+    len = std::min(len, kMaxMessage);
+    LogThreadBuffer& buf = localBuffer();
+
+    RecordHeader hdr;
+    hdr.sec   = static_cast<int64_t>(::time(nullptr));
+    hdr.len   = static_cast<uint32_t>(len);
+    hdr.fmtId = fmtId;
+    hdr.level = static_cast<uint8_t>(level);
+    hdr.kind  = kind;
+    const size_t need = sizeof(hdr) + len;
+
+    uint64_t tail = buf.tail.load(std::memory_order_relaxed);
+    // 缓冲区满了说明日志量超过了磁盘写入速度：叫醒 flusher，等它腾出空间（不丢日志）
+    while (LogThreadBuffer::kCapacity - (tail - buf.head.load(std::memory_order_acquire)) < need) {
+        if (stopped_.load(std::memory_order_acquire)) {
+            writeDirect(level, kind, fmtId, msg, len);
+            return;
+        }
+        requestFlush();
+        std::this_thread::yield();
+    }
+
+    buf.copyIn(tail, &hdr, sizeof(hdr));
+    buf.copyIn(tail + sizeof(hdr), msg, len);
+    buf.tail.store(tail + need, std::memory_order_release);
+
+    // ERROR 尽快落盘；缓冲区过半也提前叫醒，免得生产者被卡住
+    if (level == LogLevel::ERROR ||
+        tail + need - buf.head.load(std::memory_order_relaxed) > LogThreadBuffer::kCapacity / 2) {
+        requestFlush();
+    }
+}
+
+void Logger::requestFlush() {
+    // 已经有人叫过了就不再抢 wakeMtx_
+    if (flushPending_.exchange(true, std::memory_order_acq_rel)) return;
+    std::lock_guard<std::mutex> lock(wakeMtx_);
+    wakeCv_.notify_one();
+}
+
+void Logger::flusherLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMtx_);
+            wakeCv_.wait_for(lock, kFlushInterval, [this] {
+                return flushPending_.load() || stop_.load();
+            });
+        }
+        flushPending_.store(false);
+        bool stopping = stop_.load();
+        drainAll();
+        if (stopping) break;
+    }
+
+    // 之后再有日志就走 writeDirect；先拿 directMtx_ 再收最后一遍，保证不会有两边同时写文件
+    std::lock_guard<std::mutex> lock(directMtx_);
+    stopped_.store(true, std::memory_order_release);
+    drainAll();
+}
+
+void Logger::drainAll() {
+    std::vector<std::shared_ptr<LogThreadBuffer>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(regMtx_);
+        snapshot = buffers_;
+    }
+
+    const bool binary = binaryOutput_.load(std::memory_order_relaxed);
+    std::string msg;
+    for (auto& buf : snapshot) {
+        // 先看 retired 再读 tail：看到 retired 之后读到的 tail 就是最终值
+        bool retired  = buf->retired.load(std::memory_order_acquire);
+        uint64_t head = buf->head.load(std::memory_order_relaxed);
+        uint64_t tail = buf->tail.load(std::memory_order_acquire);
+
+        while (head < tail) {
+            RecordHeader hdr;
+            buf->copyOut(head, &hdr, sizeof(hdr));
+            msg.resize(hdr.len);
+            buf->copyOut(head + sizeof(hdr), &msg[0], hdr.len);
+            head += sizeof(hdr) + hdr.len;
+
+            if (hdr.kind == kStructured && binary) {
+                // 二进制模式：R | i64 sec | u8 level | u32 fmtId | u32 argLen | args
+                binBatch_.push_back('R');
+                appendRaw(binBatch_, hdr.sec);
+                appendRaw(binBatch_, hdr.level);
+                appendRaw(binBatch_, hdr.fmtId);
+                appendRaw(binBatch_, hdr.len);
+                binBatch_.append(msg);
+                continue;
+            }
+
+            std::string& batch = batches_[hdr.level & 3];
+            batch.append(formatTime(static_cast<time_t>(hdr.sec)));
+            batch.append(" | ");
+            batch.append(levelToString(hdr.level));
+            batch.append(" | ");
+            if (hdr.kind == kStructured) {
+                renderStructured(hdr.fmtId, msg.data(), msg.size(), batch);
+            } else {
+                batch.append(msg);
+            }
+            batch.push_back('\n');
+        }
+        buf->head.store(head, std::memory_order_release);
+
+        if (retired) {
+            std::lock_guard<std::mutex> lock(regMtx_);
+            buffers_.erase(std::remove(buffers_.begin(), buffers_.end(), buf), buffers_.end());
+        }
+    }
+
+    time_t now = ::time(nullptr);
+    for (int i = 0; i < 4; ++i) {
+        if (!batches_[i].empty()) writeBatch(files_[i], batches_[i], now);
+    }
+    if (!binBatch_.empty()) writeBinary(now);
+}
+
+bool Logger::maybeRotate(LogFile& file, size_t pending, time_t now) {
+    size_t maxBytes = rotateBytes_.load(std::memory_order_relaxed);
+    int    interval = rotateIntervalSec_.load(std::memory_order_relaxed);
+    if (file.size > 0 &&
+        ((maxBytes > 0 && file.size + pending > maxBytes) ||
+         (interval > 0 && now - file.openedAt >= interval))) {
+        rotateFile(file, now);
+        return true;
+    }
+    return false;
+}
+
+void Logger::writeBatch(LogFile& file, std::string& batch, time_t now) {
+    maybeRotate(file, batch.size(), now);
+
+    if (file.fd >= 0 && writeAll(file.fd, batch.data(), batch.size())) {
+        file.size += batch.size();
+    }
+    batch.clear();   // 保留容量，下一批复用
+}
+
+/*nebula.blog 文件格式（整数为本机字节序，x86 上就是小端）：
+  文件头  "NBLOG1\n"
+  格式串  F | u32 id | u8 level | u32 line | u16 fileLen | file | u32 fmtLen | fmt
+  记录    R | i64 sec | u8 level | u32 fmtId | u32 argLen | args（见 LogArgEncoder）
+每个文件自带它用到的格式串定义（轮转后的新文件会重新写一遍），单个文件就能独立解码。*/
+void Logger::writeBinary(time_t now) {
+    if (binFile_.fd < 0 && binFile_.size == 0) {
+        openFile(binFile_);   // 第一次用到才创建，文本模式下不留空文件
+        // 上次运行留下的文件里格式串编号和这次对不上，先挪走
+        if (binFile_.size > 0) rotateFile(binFile_, now);
+        formatsWritten_ = 0;
+    }
+    if (maybeRotate(binFile_, binBatch_.size(), now)) formatsWritten_ = 0;
+
+    std::string prefix;
+    if (binFile_.size == 0 && formatsWritten_ == 0) prefix.append("NBLOG1\n");
+    {
+        std::lock_guard<std::mutex> lock(fmtMtx_);
+        for (; formatsWritten_ < formats_.size(); ++formatsWritten_) {
+            const FormatInfo& f = formats_[formatsWritten_];
+            prefix.push_back('F');
+            appendRaw(prefix, static_cast<uint32_t>(formatsWritten_));
+            appendRaw(prefix, static_cast<uint8_t>(f.level));
+            appendRaw(prefix, static_cast<uint32_t>(f.line));
+            appendRaw(prefix, static_cast<uint16_t>(f.file.size()));
+            prefix.append(f.file);
+            appendRaw(prefix, static_cast<uint32_t>(f.fmt.size()));
+            prefix.append(f.fmt);
+        }
+    }
+    prefix.append(binBatch_);
+    binBatch_.clear();
+
+    if (binFile_.fd >= 0 && writeAll(binFile_.fd, prefix.data(), prefix.size())) {
+        binFile_.size += prefix.size();
+    }
+}
+
+void Logger::renderStructured(uint32_t fmtId, const char* args, size_t len, std::string& out) {
+    std::string fmt;
+    {
+        std::lock_guard<std::mutex> lock(fmtMtx_);
+        if (fmtId >= formats_.size()) {
+            out.append("<unknown log format>");
+            return;
+        }
+        fmt = formats_[fmtId].fmt;
+    }
+
+    size_t pos = 0;   // 参数读到哪了
+    char num[32];
+    for (size_t i = 0; i < fmt.size(); ++i) {
+        bool hex = false;
+        if (fmt.compare(i, 2, "{}") == 0) {
+            i += 1;
+        } else if (fmt.compare(i, 4, "{:x}") == 0) {
+            i += 3;
+            hex = true;
+        } else {
+            out.push_back(fmt[i]);
+            continue;
+        }
+
+        if (pos >= len) {
+            out.append("{}");   // 参数不够（被截断了）
+            continue;
+        }
+        char tag = args[pos++];
+        if (tag == 's') {
+            uint32_t n = 0;
+            std::memcpy(&n, args + pos, sizeof(n));
+            pos += sizeof(n);
+            out.append(args + pos, n);
+            pos += n;
+        } else if (tag == 'b') {
+            out.append(args[pos] ? "true" : "false");
+            pos += 1;
+        } else if (tag == 'd') {
+            double v;
+            std::memcpy(&v, args + pos, sizeof(v));
+            pos += sizeof(v);
+            snprintf(num, sizeof(num), "%g", v);
+            out.append(num);
+        } else {
+            // 'i' / 'u' / 'p' 都是 8 字节整数
+            uint64_t v;
+            std::memcpy(&v, args + pos, sizeof(v));
+            pos += sizeof(v);
+            if (hex || tag == 'p') {
+                snprintf(num, sizeof(num), tag == 'p' ? "0x%llx" : "%llx",
+                         static_cast<unsigned long long>(v));
+            } else if (tag == 'i') {
+                snprintf(num, sizeof(num), "%lld", static_cast<long long>(v));
+            } else {
+                snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(v));
+            }
+            out.append(num);
+        }
+    }
+}
+
+void Logger::openFile(LogFile& file) {
+    file.fd = ::open(file.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    file.size = 0;
+    struct stat st;
+    if (file.fd >= 0 && ::fstat(file.fd, &st) == 0) file.size = static_cast<size_t>(st.st_size);
+    file.openedAt = ::time(nullptr);
+}
+
+void Logger::rotateFile(LogFile& file, time_t now) {
+    if (file.fd >= 0) ::close(file.fd);
+
+    tm lt;
+    localtime_r(&now, &lt);
+    char suffix[32];
+    std::strftime(suffix, sizeof(suffix), "%Y%m%d-%H%M%S", &lt);
+
+    // 同一秒里轮转多次时加序号，别把上一份覆盖掉
+    std::string target = file.path + "." + suffix;
+    for (int i = 1; std::filesystem::exists(target); ++i) {
+        target = file.path + "." + suffix + "." + std::to_string(i);
+    }
+    std::error_code ec;
+    std::filesystem::rename(file.path, target, ec);
+
+    openFile(file);
+}
+
+void Logger::writeDirect(LogLevel level, uint8_t kind, uint32_t fmtId, const char* msg, size_t len) {
+    std::lock_guard<std::mutex> lock(directMtx_);
+    LogFile& file = files_[static_cast<int>(level) & 3];
+    if (file.fd < 0) return;
+
+    std::string line;
+    line.reserve(len + 40);
+    line.append(formatTime(::time(nullptr)));
+    line.append(" | ");
+    line.append(levelToString(static_cast<int>(level)));
+    line.append(" | ");
+    if (kind == kStructured) {
+        renderStructured(fmtId, msg, len, line);
+    } else {
+        line.append(msg, len);
+    }
+    line.push_back('\n');
+    if (writeAll(file.fd, line.data(), line.size())) file.size += line.size();
+}
+
+const char* Logger::formatTime(time_t sec) {
+    if (sec != cachedSec_) {
+        tm lt;
+        localtime_r(&sec, &lt);
+        snprintf(cachedTime_, sizeof(cachedTime_), "%04d-%02d-%02d %02d:%02d:%02d",
+                 lt.tm_year + 1900, lt.tm_mon + 1, lt.tm_mday,
+                 lt.tm_hour, lt.tm_min, lt.tm_sec);
+        cachedSec_ = sec;
+    }
+    return cachedTime_;
+}
@@ -0,0 +1,41 @@
+#include "core/OutputQueue.h"
+#include <sys/uio.h>
+#include <errno.h>
+
+ssize_t OutputQueue::writeFd(int fd, int* savedErrno) {
+    struct iovec vec[kMaxIov];
+    int cnt = 0;
+
+    for (auto it = chunks_.begin(); it != chunks_.end() && cnt < kMaxIov; ++it, ++cnt) {
+        vec[cnt].iov_base = const_cast<char*>(it->data->data()) + it->offset;
+        vec[cnt].iov_len  = it->data->size() - it->offset;
+    }
+    if (cnt == 0) return 0;
+
+    const ssize_t n = ::writev(fd, vec, cnt);
+    if (n < 0) {
+        *savedErrno = errno;
+        return n;
+    }
+    consume(static_cast<size_t>(n));
+    return n;
+}
+
+void OutputQueue::consume(size_t n) {
+    bytes_ -= n;
+    while (n > 0 && !chunks_.empty()) {
+        Chunk& head = chunks_.front();
+        size_t left = head.data->size() - head.offset;
+        if (n < left) {
+            head.offset += n;
+            break;
+        }
+        n -= left;
+        chunks_.pop_front();
+    }
+
+    if (aboveHigh_ && bytes_ <= lowMark_) {
+        aboveHigh_ = false;
+        if (onLow_) onLow_(bytes_);
+    }
+}
@@ -7,6 +7,7 @@
 #include <sys/eventfd.h>
 #include <stdexcept>
 #include <cstring> 
+#include <chrono>
 using namespace std;
 
 namespace{
@@ -51,8 +52,7 @@ namespace{
       // 读一次就够 – 多次 write 会累加到 counter 里
       ssize_t n = ::read(evfd, &counter, sizeof(counter));
       (void)n;
-      LOG_DEBUG("[Reactor::DrainEvent] drained eventfd=" << evfd
-                << " counter=" << counter);
+      LOGF_DEBUG("[Reactor::DrainEvent] drained eventfd={} counter={}", evfd, counter);
   }
 }
 
@@ -160,9 +160,7 @@ bool reactor::modFd(int fd, uint32_t events, void* user){
         users_[fd] = user;
     }
 
-    LOG_DEBUG("[Reactor::modFd] fd=" << fd
-              << " events=0x" << std::hex << events << std::dec
-              << " useET=" << (useET ? "true" : "false"));
+    LOGF_DEBUG("[Reactor::modFd] fd={} events=0x{:x} useET={}", fd, events, useET);
 
     // 建议外部自行保证 fd 已非阻塞
     return true;
@@ -201,7 +199,7 @@ void reactor::wakeup(){
         LOG_ERROR("[Reactor::wakeup] write to evfd_ failed, n=" << n
                   << " errno=" << errno << " (" << strerror(errno) << ")");
     } else {
-        LOG_DEBUG("[Reactor::wakeup] wakeup sent to evfd_=" << evfd_);
+        LOGF_DEBUG("[Reactor::wakeup] wakeup sent to evfd_={}", evfd_);
     }
     // (void)n 的真正作用：消除未使用变量警告
     (void) n;
@@ -214,16 +212,21 @@ void reactor::loop(){
     }
     LOG_INFO("[Reactor::loop] event loop start");
 
+    threadId_.store(std::this_thread::get_id(), std::memory_order_release);
     running_.store(true, std::memory_order_release);
     //这是为了让其它线程修改 running_ 时，
     // Reactor.loop() 能立刻退出，并保证跨线程内存可见性。
-    while(running_.load(std::memory_order_acquire)){
+    while(running_.load(std::memory_order_acquire) &&
+          !quit_.load(std::memory_order_acquire)){
         //static_cast 是 C++ 中 最常用、最安全、最应该使用的显式类型转换运算符。
         //这个eventList_是用来接受epoll看到哪里io变化的，
         // 比如我的epoll看到有2个io变化了，
         // n = 2,
         // 例eventList[0].data.fd = 6; evenrList_[1].data.fd = 19; 
-        int n = ::epoll_wait(epfd_, eventList_.data(), static_cast<int>(eventList_.size()), -1);
+        // 有定时器就最多睡到下一个需要推进时间轮的时刻，没有就一直睡
+        int timeoutMs = timers_.nextTimeoutMs(nowMs());
+        int n = ::epoll_wait(epfd_, eventList_.data(), static_cast<int>(eventList_.size()), timeoutMs);
+        pollReturnMs_ = nowMs();
         if (n < 0) {
             if (errno == EINTR) {
                 LOG_DEBUG("[Reactor::loop] epoll_wait interrupted by signal, retry");
@@ -236,12 +239,12 @@ void reactor::loop(){
         }
 
         if (n == 0) {
-            // 理论上 timeout=-1 不会到这里，这里只是保险
-            LOG_DEBUG("[Reactor::loop] epoll_wait returns 0 (no events)");
+            // 超时醒来：只有定时器要处理
+            timers_.advance(pollReturnMs_);
             continue;
         }
 
-        LOG_DEBUG("[Reactor::loop] epoll_wait returns n=" << n << " events");
+        LOGF_DEBUG("[Reactor::loop] epoll_wait returns n={} events", n);
         
         for(int i = 0; i < n; ++i){
             int fd = eventList_[i].data.fd;
@@ -253,8 +256,8 @@ void reactor::loop(){
             // 就像你有需求像领导汇报，
             // 肯定得汇报给某个leader然后他再去汇报
             if(fd == evfd_){
-                LOG_DEBUG("[Reactor::loop] got wakeup event on evfd_=" << evfd_
-                          << " events=0x" << std::hex << events << std::dec);
+                LOGF_DEBUG("[Reactor::loop] got wakeup event on evfd_={} events=0x{:x}",
+                           evfd_, events);
                 // 消耗唤醒信号
                 //因为本生我的eventFd就是用来唤醒epoll这一个作用，
                 // 如果这次不读完eventfd里面的计数的话，
@@ -272,19 +275,25 @@ void reactor::loop(){
                 if (temp != users_.end()) user = temp->second;
             }
 
-            LOG_DEBUG("[Reactor::loop] dispatch fd=" << fd
-                      << " events=0x" << std::hex << events << std::dec
-                      << " user=" << user);
+            LOGF_DEBUG("[Reactor::loop] dispatch fd={} events=0x{:x} user={}", fd, events, user);
 
             // 交给上层派发（Server::Dispatch）
             dispatcher_(fd, events, user);
         }
+
+        // 这一批 IO 事件处理完，再执行其它线程投递过来的任务
+        doPendingFunctors();
+        // 最后处理到期的定时器
+        timers_.advance(nowMs());
     }
 
+    // 退出后允许再进一次 loop()（优雅关闭时主 reactor 要再跑一段，等连接排空）
+    quit_.store(false, std::memory_order_release);
     LOG_INFO("[Reactor::loop] event loop exit");
 }
 
 void reactor::stop(){
+    quit_.store(true, std::memory_order_release);
     bool expected = true;
     if(running_.compare_exchange_strong(expected, false, std::memory_order_acq_rel)){
         LOG_INFO("[Reactor::stop] set running_=false, wakeup loop");
@@ -294,6 +303,81 @@ void reactor::stop(){
     }
 }
 
+void reactor::stopFromSignal(){
+    static_assert(std::atomic<bool>::is_always_lock_free,
+                  "quit_ must be lock-free to be set from a signal handler");
+    quit_.store(true, std::memory_order_release);
+    // 不走 wakeup()：它失败时会打日志。信号打断的就是 loop 线程时 epoll_wait 返回 EINTR，也会看到 quit_
+    uint64_t one = 1;
+    ssize_t n = ::write(evfd_, &one, sizeof(one));
+    (void) n;
+}
+
+void reactor::queueInLoop(Functor cb){
+    pendingFunctors_.push(std::move(cb));
+    // 之前队列是空的（loop 可能正睡在 epoll_wait 里）才需要写 eventfd；
+    // 否则 loop 已经欠着一次 drain，会顺手把这个任务一起执行掉
+    if (pendingCount_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+        wakeup();
+    }
+}
+
+void reactor::runInLoop(Functor cb){
+    if (isInLoopThread()) {
+        cb();
+    } else {
+        queueInLoop(std::move(cb));
+    }
+}
+
+void reactor::doPendingFunctors(){
+    int64_t done = 0;
+    Functor f;
+    // 回调里再 queueInLoop 也没问题：新任务要么这一轮就被取到，要么留到下一轮
+    while (pendingFunctors_.pop(f)) {
+        f();
+        f = nullptr;
+        ++done;
+    }
+    if (done == 0 && pendingCount_.load(std::memory_order_acquire) == 0) return;
+
+    int64_t left = pendingCount_.fetch_sub(done, std::memory_order_acq_rel) - done;
+    if (left > 0) {
+        // 有生产者在我们 drain 期间投递了任务，它看到计数不为 0 不会去唤醒，
+        // 而它的节点可能还没挂上（或者刚好在 drain 结束后才挂上），自己补一次唤醒，下一轮再取
+        wakeup();
+    }
+    if (done > 0) {
+        LOGF_DEBUG("[Reactor::doPendingFunctors] run {} functors", done);
+    }
+}
+
+int64_t reactor::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+reactor::TimerId reactor::runAfter(int64_t delayMs, Functor cb) {
+    return addTimer(delayMs, 0, std::move(cb));
+}
+
+reactor::TimerId reactor::runEvery(int64_t intervalMs, Functor cb) {
+    return addTimer(intervalMs, intervalMs > 0 ? intervalMs : 1, std::move(cb));
+}
+
+reactor::TimerId reactor::addTimer(int64_t delayMs, int64_t intervalMs, Functor cb) {
+    TimerId id = nextTimerId_.fetch_add(1, std::memory_order_relaxed);
+    // 在 loop 线程里直接插入；别的线程投递过去，顺带把 epoll_wait 叫醒重新算超时
+    runInLoop([this, id, delayMs, intervalMs, cb = std::move(cb)]() mutable {
+        timers_.add(id, nowMs(), delayMs, intervalMs, std::move(cb));
+    });
+    return id;
+}
+
+void reactor::cancel(TimerId id) {
+    runInLoop([this, id]() { timers_.cancel(id); });
+}
+
 int reactor::wakeUpFd()const{
     return  evfd_;
 }
@@ -1,5 +1,8 @@
 #include "core/Server.h"
 #include "core/Logger.h"
+#include "core/Strand.h"
+#include "core/ListenerHandoff.h"
+#include "chat/ChatCodec.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -8,14 +11,28 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <cstring>
+#include <algorithm>
 #include <iostream>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
+using utils::WireProtocol;
 
 
-Server::Server(reactor& rect, uint16_t port, bool useET, ThreadPool* pool)
-    : reactor_(rect), Threadpool_(pool), port_(port), useET_(useET) {}
+Server::Server(reactor& rect, uint16_t port, bool useET, ThreadPool* pool, int ioThreads)
+    : reactor_(rect), Threadpool_(pool), port_(port), useET_(useET)
+{
+    if (ioThreads < 0) {
+        // 默认一个核一个 IO 线程
+        unsigned hc = std::thread::hardware_concurrency();
+        ioThreads = hc > 0 ? static_cast<int>(hc) : 1;
+    }
+    ioThreads_ = ioThreads;
+    if (pool) {
+        // 留四分之一余量给 strand 的排空任务和后台任务，保证 loop 线程的 TryEnqueue 基本不会失败
+        busyHighWater_ = pool->capacity() * 3 / 4;
+    }
+}
 
 Server::~Server() { stop(); }
 
@@ -30,7 +47,13 @@ bool Server::start() {
 
     bool ok = false; // 用于统一收尾
     do {
-        listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+        // 热重启：旧进程还在跑就直接接过它的监听 socket（已经 bind + listen 过了）
+        bool inherited = false;
+        if (!handoffPath_.empty()) {
+            listenFd_ = handoff::receiveListener(handoffPath_, port_);
+            inherited = listenFd_ >= 0;
+        }
+        if (!inherited) listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
 
         if (listenFd_ < 0) {
             perror("socket");
@@ -63,34 +86,100 @@ bool Server::start() {
 
         reinterpret_cast = 野蛮、按字节解释的转换
         → “我知道风险，我硬要把 A 当 B 用”*/
-        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (!inherited &&
+            ::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
             perror("bind");
             LOG_ERROR("[Server::start] bind failed: " << strerror(errno));
             break;
         }
 
         //n -> 允许同时连接的客户端数量
-        if (::listen(listenFd_, 128) < 0) {
+        if (!inherited && ::listen(listenFd_, 128) < 0) {
             perror("listen");
             LOG_ERROR("[Server::start] listen failed: " << strerror(errno));
             break;
         }
 
+        // 创建 IO loop：ioThreads_ == 0 时只有一个 loop，直接复用主 reactor
+        loops_.clear();
+        try {
+            if (ioThreads_ == 0) {
+                auto lp = std::make_unique<IoLoop>();
+                lp->rt = &reactor_;
+                loops_.push_back(std::move(lp));
+            } else {
+                for (int i = 0; i < ioThreads_; ++i) {
+                    auto lp = std::make_unique<IoLoop>();
+                    lp->owned = std::make_unique<reactor>(1024, useET_);
+                    lp->rt    = lp->owned.get();
+                    IoLoop* raw = lp.get();
+                    lp->rt->setDispatcher([this, raw](int fd, uint32_t events, void* user) {
+                        this->onEvent(*raw, fd, events, user);
+                    });
+                    loops_.push_back(std::move(lp));
+                }
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("[Server::start] create io loops failed: " << e.what());
+            loops_.clear();
+            break;
+        }
+
         // 把监听 fd 加入 epoll，才能收到连接事件
         if (!reactor_.addFd(listenFd_, EPOLLIN, nullptr)) {
             LOG_ERROR("[Server::start] reactor add listenFd_ failed");
             break;
         }
         
+        // 控制 socket：下一个版本的进程启动时从这里把监听 fd 要走；开不了只是不能热重启，不影响服务
+        if (!handoffPath_.empty()) {
+            controlFd_ = handoff::openControlSocket(handoffPath_);
+            if (controlFd_ >= 0 && !reactor_.addFd(controlFd_, EPOLLIN, nullptr)) {
+                LOG_ERROR("[Server::start] reactor add controlFd_ failed, hot restart disabled");
+                ::close(controlFd_);
+                controlFd_ = -1;
+            }
+        }
+
         // 绑定分发回调（建议只设置一次）
+        // 多 reactor 模式下主 reactor 上只有 listenFd_，单 reactor 模式下 loops_[0] 就是主 reactor
+        // 监听 fd 和控制 socket 只注册在主 reactor 上，在这里截下来：子 reactor 线程从不读 listenFd_ / controlFd_
         reactor_.setDispatcher([this](int fd, uint32_t events, void* user) {
-            this->onEvent(fd, events, user);
+            if (fd == listenFd_ || fd == controlFd_) {
+                this->onListenerEvent(fd, events);
+                return;
+            }
+            this->onEvent(*loops_.front(), fd, events, user);
         });
 
+        // 子 reactor 各自一个线程跑 loop()
+        for (auto& lp : loops_) {
+            if (!lp->owned) continue;
+            reactor* rt = lp->rt;
+            lp->th = std::thread([rt]() { rt->loop(); });
+        }
+
+        // 每个 loop 一个粗粒度的心跳扫描定时器：超时的三分之一扫一次，误差最多多三分之一
+        if (heartbeatTimeoutMs_ > 0) {
+            int64_t sweepMs = std::max<int64_t>(heartbeatTimeoutMs_ / 3, 1000);
+            for (auto& lp : loops_) {
+                IoLoop* raw = lp.get();
+                lp->rt->runEvery(sweepMs, [this, raw]() { sweepDeadSessions(*raw); });
+            }
+        }
+
+        // outbuf 积压巡检：只看数字、打日志，不影响连接
+        for (auto& lp : loops_) {
+            IoLoop* raw = lp.get();
+            lp->rt->runEvery(kBacklogReportMs, [this, raw]() { reportOutputBacklog(*raw); });
+        }
+
         std::cout << "[Server::start] Server listening on port " << port_
-                  << " (ET=" << (useET_ ? "on" : "off") << ")\n";
+                  << " (ET=" << (useET_ ? "on" : "off")
+                  << ", ioThreads=" << ioThreads_ << ")\n";
         LOG_INFO("[Server::start] Server listening on port " << port_
-                 << " (ET=" << (useET_ ? "on" : "off") << ")");
+                 << " (ET=" << (useET_ ? "on" : "off")
+                 << ", ioThreads=" << ioThreads_ << ")");
         ok = true;
     } while (false);
 
@@ -118,44 +207,186 @@ void Server::stop() {
     std::cout << "[Server::stop] stopping server on port " << port_ << "\n";
     LOG_INFO("[Server::stop] stopping server on port " << port_);
 
+    if (listenFd_ != -1 || controlFd_ != -1) {
+        stopAccepting();
+        std::cout << "[Server::stop] listenFd_ closed\n";
+        LOG_INFO("[Server::stop] listenFd_ closed");
+    }
+
+    // 先停掉子 reactor 并 join，之后各 loop 的 conns 就不会再被 IO 线程修改
+    for (auto& lp : loops_) {
+        if (lp->owned) lp->rt->stop();
+    }
+    for (auto& lp : loops_) {
+        if (lp->th.joinable()) lp->th.join();
+    }
+
+    //走到这里所有 loop 都已经退出（单 reactor 模式下 stop() 在主 loop 返回后调用），
+    //conns 只剩当前线程在碰
+    size_t total = 0;
+    for (auto& lp : loops_) {
+        total += lp->conns.size();
+    }
+    std::cout << "[Server::stop] closing " << total << " active connections\n";
+    LOG_INFO("[Server::stop] closing " << total << " active connections");
+    Stats st = stats();
+    LOG_INFO("[Server::stop] overload stats: rejected=" << st.rejected
+             << " readPauses=" << st.readPauses << " inflight=" << st.inflight
+             << " pings=" << st.pings << " deadSessions=" << st.deadSessions
+             << " slowConsumers=" << st.slowConsumers
+             << " droppedBroadcasts=" << st.droppedBroadcasts
+             << " evictedSlow=" << st.evictedSlow);
+
+    for (auto& lp : loops_) {
+        for (auto& kv : lp->conns) {
+            int fd = kv.first;
+            kv.second->closed.store(true);
+            lp->rt->delFd(fd);
+            ::close(fd);
+        }
+        lp->conns.clear();
+    }
+}
+
+void Server::stopAccepting() {
     if (listenFd_ != -1) {
+        // 交接过的话内核里的监听 socket 还被新进程开着，这里只是关掉自己这份
         reactor_.delFd(listenFd_);
         ::close(listenFd_);
         listenFd_ = -1;
-        std::cout << "[Server::stop] listenFd_ closed\n";
-        LOG_INFO("[Server::stop] listenFd_ closed");
     }
+    if (controlFd_ != -1) {
+        reactor_.delFd(controlFd_);
+        ::close(controlFd_);
+        controlFd_ = -1;
+        // 交接之后这个路径已经被新进程重新 bind 了，不能删
+        if (!handedOff_) ::unlink(handoffPath_.c_str());
+    }
+}
 
-    //conns_ 是多线程共享容器，必须加锁，否则会在 stop() 清理时被其他线程同时修改导致崩溃。
-    std::lock_guard<std::mutex> lock(conns_mtx_);
-    std::cout << "[Server::stop] closing " << conns_.size() << " active connections\n";
-    LOG_INFO("[Server::stop] closing " << conns_.size() << " active connections");
-    for (auto& kv : conns_) {
-        int fd = kv.first;
-        reactor_.delFd(fd);
-        ::close(fd);
+void Server::onHandoffRequest() {
+    if (listenFd_ == -1) return;
+    if (!handoff::sendListener(controlFd_, listenFd_, port_)) return;
+
+    handedOff_ = true;
+    stopAccepting();
+    std::cout << "[Server::onHandoffRequest] listen socket handed to the new process, draining\n";
+    LOG_INFO("[Server::onHandoffRequest] listen socket handed to the new process, draining");
+    // 让主 loop 返回，main 接着 drain()：老连接排空之前新进程已经在 accept 了
+    reactor_.stop();
+}
+
+void Server::drain(int64_t timeoutMs) {
+    if (!running_.load()) return;
+
+    stopAccepting();
+    LOG_INFO("[Server::drain] draining connections, timeout=" << timeoutMs << "ms");
+
+    for (auto& lp : loops_) {
+        IoLoop* raw = lp.get();
+        raw->drained.store(false);
+        raw->rt->runInLoop([this, raw]() { beginDrain(*raw); });
     }
-    conns_.clear();
+
+    // 主 reactor 再跑一段（单 reactor 模式下连接也在它上面）：都排空了或者到点了就退出
+    int64_t deadline = reactor::nowMs() + timeoutMs;
+    bool allDrained = false;
+    reactor::TimerId watch = reactor_.runEvery(kDrainCheckMs, [this, deadline, &allDrained]() {
+        allDrained = std::all_of(loops_.begin(), loops_.end(),
+                                 [](const auto& lp) { return lp->drained.load(); });
+        if (allDrained || reactor::nowMs() >= deadline) reactor_.stop();
+    });
+    reactor_.loop();
+    reactor_.cancel(watch);
+
+    if (allDrained) {
+        LOG_INFO("[Server::drain] all connections drained");
+    } else {
+        LOG_WARN("[Server::drain] drain timed out after " << timeoutMs
+                 << "ms, closing the remaining connections");
+    }
+    stop();
 }
 
-/*处理监听事件，有端口想要访问就加入reactor管理,反之就是有加入的客户端想要完成写或者读*/
-void Server::onEvent(int fd, uint32_t events, void* user) {
-    // 错误/挂起优先处理
+void Server::beginDrain(IoLoop& loop) {
+    loop.draining = true;
+    // drainConn 里写失败会 closeConn 改 conns，先拷一份
+    std::vector<ConnectionPtr> conns;
+    conns.reserve(loop.conns.size());
+    for (const auto& kv : loop.conns) conns.push_back(kv.second);
+    for (const auto& c : conns) drainConn(loop, c);
+
+    // 在途计数是在回包进了 outbuf 之后才在 loop 线程里扣的（见 finishRequest），
+    // 看到 inflight == 0 && outbuf 空就可以直接关
+    loop.drainTimer = loop.rt->runEvery(kDrainCheckMs, [this, lp = &loop]() {
+        checkDrained(*lp);
+    });
+}
+
+void Server::drainConn(IoLoop& loop, const ConnectionPtr& connPtr) {
+    Connection& c = *connPtr;
+    if (c.closed) return;
+    if (c.proto != WireProtocol::Unknown) {
+        static const json notice = {{"ok", true}, {"cmd", "shutdown"},
+                                    {"reconnect", true}, {"broadcast", true}};
+        sendInLoop(loop, c, std::make_shared<const std::string>(
+                                chat::encodePush(c.proto, notice)), false);
+        if (c.closed) return;
+    }
+    // 不再读新请求；已经在处理的照常回（resumeReading 在 draining 时不会把读打开）
+    if (!c.readPaused) {
+        c.readPaused = true;
+        updateEvents(loop, c);
+    }
+}
+
+void Server::checkDrained(IoLoop& loop) {
+    std::vector<int> idle;
+    for (const auto& kv : loop.conns) {
+        const Connection& c = *kv.second;
+        if (c.inflight.load(std::memory_order_acquire) == 0 && c.outbuf.empty()) {
+            idle.push_back(kv.first);
+        }
+    }
+    for (int fd : idle) closeConn(fd);
+
+    if (loop.conns.empty() && !loop.drained.load()) {
+        loop.rt->cancel(loop.drainTimer);
+        loop.drainTimer = 0;
+        loop.drained.store(true);
+        LOG_INFO("[Server::checkDrained] loop drained");
+    }
+}
+
+/*处理监听事件（只在主 reactor 线程）：有端口想要访问就加入reactor管理*/
+void Server::onListenerEvent(int fd, uint32_t events) {
     if (events & (EPOLLERR | EPOLLHUP)) {
-        LOG_ERROR("[Server::onEvent] EPOLLERR/EPOLLHUP on fd=" << fd);
-        closeConn(fd);
+        LOG_ERROR("[Server::onListenerEvent] EPOLLERR/EPOLLHUP on fd=" << fd);
         return;
     }
 
-    if (fd == listenFd_) {
-        /*如果事件events 位与(全1为1)上,
-        用位与来判断events里面是否有这个事件，
-        如果没有这个事件，
-        我的events & “事件”就是为0不会执行这个语句了*/
-        if (events & EPOLLIN) {
-            LOG_DEBUG("[Server::onEvent] EPOLLIN on listenFd_, accepting new connections");
-            onAccept();
-        }
+    if (fd == controlFd_) {
+        // 热重启：新进程连上来要监听 fd
+        if (events & EPOLLIN) onHandoffRequest();
+        return;
+    }
+
+    /*如果事件events 位与(全1为1)上,
+    用位与来判断events里面是否有这个事件，
+    如果没有这个事件，
+    我的events & “事件”就是为0不会执行这个语句了*/
+    if (events & EPOLLIN) {
+        LOG_DEBUG("[Server::onListenerEvent] EPOLLIN on listenFd_, accepting new connections");
+        onAccept();
+    }
+}
+
+/*处理连接上的事件：有加入的客户端想要完成写或者读*/
+void Server::onEvent(IoLoop& loop, int fd, uint32_t events, void* /*user*/) {
+    // 错误/挂起优先处理
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        LOG_ERROR("[Server::onEvent] EPOLLERR/EPOLLHUP on fd=" << fd);
+        closeConn(fd);
         return;
     }
 
@@ -166,21 +397,19 @@ void Server::onEvent(int fd, uint32_t events, void* user) {
     uPtr->fd = 10;//这个只是实现得像指针但是uPtr实际上还是只是个对象，
     只是封装这个unique_ptr的人想把他变得跟指针一样的用法才这样写的
     */
-    std::unique_ptr<Connection>* p_holder = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(conns_mtx_);
-        auto it = conns_.find(fd);
-        if (it == conns_.end()) {
-            LOG_ERROR("[Server::onEvent] fd=" << fd << " not found in conns_");
-            return;
-        }
-        p_holder = &it->second;
+    /*这里拷贝一份 shared_ptr 出来：
+    onConnRead 里可能 closeConn 把它从 conns 里删掉，
+    本次回调结束前连接对象都还活着*/
+    auto it = loop.conns.find(fd);
+    if (it == loop.conns.end()) {
+        LOG_ERROR("[Server::onEvent] fd=" << fd << " not found in conns");
+        return;
     }
+    ConnectionPtr conn = it->second;
 
-    Connection& conn = *p_holder->get();
-
-    if (events & EPOLLIN)  onConnRead(conn);
-    if (events & EPOLLOUT) onConnWrite(conn);
+    if (events & EPOLLIN)  onConnRead(loop, conn);
+    // 读的时候可能已经关掉了，不能再写
+    if ((events & EPOLLOUT) && !conn->closed) onConnWrite(*conn);
 }
 
 /*处理新的连接事件，加入我的reactor管理*/
@@ -219,40 +448,101 @@ void Server::onAccept() {
 
         setTcpNoDelay(clientfd);
 
-        auto conn = std::make_unique<Connection>();
+        auto conn = std::make_shared<Connection>();
         conn->fd = clientfd;
+        conn->id = nextConnId_++;
         //默认没有登陆
         conn->authed = false;
         conn->userId = 0;           // MYSQL已实现功能
         conn->name.clear();         // MYSQL已实现功能
-        conn->roomId = 0;           
-        Connection* user_ptr = conn.get();
+        conn->roomId = 0;
+        conn->joiningRoomId = 0;
+        conn->strand = std::make_shared<Strand>(*Threadpool_);
 
-        {
-            std::lock_guard<std::mutex> lock(conns_mtx_);
-            conns_.emplace(clientfd, std::move(conn));
+        IoLoop& lp = loopOf(clientfd);
+        if (lp.rt == &reactor_) {
+            // 单 reactor 模式：就在当前线程注册
+            registerConn(lp, conn);
+        } else {
+            // 交给子 reactor：放进它的任务队列并通过 eventfd 唤醒，由它自己的线程注册 epoll
+            IoLoop* target = &lp;
+            lp.rt->queueInLoop([this, target, conn]() {
+                registerConn(*target, conn);
+            });
         }
+    }
+}
 
-        if (!reactor_.addFd(clientfd, EPOLLIN, user_ptr)) {
-            LOG_ERROR("[Server::onAccept] reactor addFd(" << clientfd << ") failed, close");
-            std::lock_guard<std::mutex> lock(conns_mtx_);
-            conns_.erase(clientfd);
-            ::close(clientfd);
-            continue;
-        }
+/*在连接所属的 loop 线程里把连接放进 conns 并注册读事件*/
+void Server::registerConn(IoLoop& loop, const ConnectionPtr& conn) {
+    int fd = conn->fd;
+    loop.conns.emplace(fd, conn);
+
+    if (!loop.rt->addFd(fd, EPOLLIN, conn.get())) {
+        LOG_ERROR("[Server::registerConn] reactor addFd(" << fd << ") failed, close");
+        loop.conns.erase(fd);
+        conn->closed.store(true);
+        ::close(fd);
+        return;
     }
+
+    conn->lastActiveMs = reactor::nowMs();
+    if (idleTimeoutMs_ > 0) armIdleTimer(loop, conn, idleTimeoutMs_);
+
+    // 回调是 outbuf 自己调的，outbuf 是连接的成员，拿裸指针就够了
+    Connection* raw = conn.get();
+    conn->outbuf.setWaterMarks(outputHighWater_, outputLowWater_,
+        [this, raw](size_t bytes) { onOutputHighWater(*raw, bytes); },
+        [this, raw](size_t bytes) { onOutputLowWater(*raw, bytes); });
+
+    // 停止 accept 之前刚接进来、排队等注册的连接
+    if (loop.draining) drainConn(loop, conn);
+}
+
+void Server::armIdleTimer(IoLoop& loop, const ConnectionPtr& conn, int64_t delayMs) {
+    // 定时器里只拿 weak_ptr：连接关掉之后不会因为还挂着定时器而不释放
+    std::weak_ptr<Connection> weak = conn;
+    conn->idleTimer = loop.rt->runAfter(delayMs, [this, lp = &loop, weak]() {
+        onIdleTimer(*lp, weak);
+    });
+}
+
+void Server::onIdleTimer(IoLoop& loop, const std::weak_ptr<Connection>& weakConn) {
+    ConnectionPtr conn = weakConn.lock();
+    if (!conn || conn->closed) return;
+    conn->idleTimer = 0;
+
+    int64_t now = reactor::nowMs();
+    // 服务端还欠着它的回包（在途请求 / 暂停读）时不算空闲
+    if (conn->readPaused || conn->inflight.load(std::memory_order_relaxed) > 0) {
+        conn->lastActiveMs = now;
+    }
+
+    int64_t idle = now - conn->lastActiveMs;
+    if (idle >= idleTimeoutMs_) {
+        LOG_INFO("[Server::onIdleTimer] fd=" << conn->fd << " idle for " << idle
+                 << " ms, closing");
+        closeConn(conn->fd);
+        return;
+    }
+    // 期间读到过数据：按剩下的时间重新挂一次（读的时候不用动定时器）
+    armIdleTimer(loop, conn, idleTimeoutMs_ - idle);
 }
 
 
 /*读客户端发送的东西，解析*/
-void Server::onConnRead(Connection& conn) {
-    char buff[1024];
+void Server::onConnRead(IoLoop& loop, const ConnectionPtr& connPtr) {
+    Connection& conn = *connPtr;
+    // 暂停读期间摘掉了 EPOLLIN，这里只可能是 EPOLLOUT 同一批带过来的旧事件：数据留在内核里
+    if (conn.readPaused) return;
     for (;;) {
-        ssize_t n = ::read(conn.fd, buff, sizeof(buff));
+        int savedErrno = 0;
+        // readv：先填 inbuf 的剩余空间，放不下的进栈上 extrabuf，一次读完一大块
+        ssize_t n = conn.inbuf.readFd(conn.fd, &savedErrno);
         if (n > 0) {
-            conn.inbuf.append(buff, n);
-            LOG_DEBUG("[Server::onConnRead] fd=" << conn.fd
-                      << " read " << n << " bytes, inbuf size=" << conn.inbuf.size());
+            conn.lastActiveMs = loop.rt->pollReturnMs();
+            LOGF_DEBUG("[Server::onConnRead] fd={} read {} bytes, inbuf size={}",
+                       conn.fd, n, conn.inbuf.readableBytes());
             continue;
         }
         if (n == 0) {
@@ -261,114 +551,381 @@ void Server::onConnRead(Connection& conn) {
             closeConn(conn.fd);
             return;
         }
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
             // 读尽
-            LOG_DEBUG("[Server::onConnRead] fd=" << conn.fd
-                      << " read all data (EAGAIN/EWOULDBLOCK)");
+            LOGF_DEBUG("[Server::onConnRead] fd={} read all data (EAGAIN/EWOULDBLOCK)", conn.fd);
             break;
         }
 
-        perror("read");
         LOG_ERROR("[Server::onConnRead] read error on fd=" << conn.fd
-                  << ": " << strerror(errno));
+                  << ": " << strerror(savedErrno));
         closeConn(conn.fd);
         return; // 读出错直接结束，不再解析 inbuf
     }
 
+    processInput(loop, connPtr);
+}
+
+void Server::processInput(IoLoop& loop, const ConnectionPtr& connPtr) {
+    Connection& conn = *connPtr;
+
+    // 刚连上：看开头几个字节是不是二进制握手，决定这个连接以后怎么拆包
+    if (conn.proto == WireProtocol::Unknown) {
+        conn.proto = chat::detectProtocol(conn.inbuf.peek(), conn.inbuf.readableBytes());
+        if (conn.proto == WireProtocol::Unknown) return;   // 握手还没收全
+        if (conn.proto == WireProtocol::Binary) {
+            conn.inbuf.retrieve(sizeof(chat::kBinaryMagic));
+            // 原样回 4 字节魔数，告诉客户端服务端支持二进制协议
+            static const Slice ack = std::make_shared<const std::string>(
+                chat::kBinaryMagic, sizeof(chat::kBinaryMagic));
+            sendInLoop(loop, conn, ack, false);
+            if (conn.closed) return;
+            LOG_INFO("[Server::onConnRead] fd=" << conn.fd << " switched to binary protocol");
+        }
+    }
+
+    if (conn.proto == WireProtocol::Binary) {
+        // 二进制协议：按 [u32 len][u8 opcode][payload] 拆帧
+        while (!conn.readPaused && !conn.closed) {
+            uint8_t op = 0;
+            std::string payload;
+            chat::FrameStatus st = chat::takeFrame(conn.inbuf, op, payload);
+            if (st == chat::FrameStatus::NeedMore) break;
+            if (st == chat::FrameStatus::Bad) {
+                LOG_ERROR("[Server::onConnRead] fd=" << conn.fd << " bad frame length, close");
+                closeConn(conn.fd);
+                return;
+            }
+            LOGF_DEBUG("[Server::onConnRead] fd={} got one frame op={} len={}",
+                       conn.fd, op, payload.size());
+            if (chat::isPing(op, payload.data(), payload.size()) && replyPong(loop, conn, op)) {
+                continue;
+            }
+            dispatchRequest(loop, connPtr, op, std::move(payload));
+        }
+        return;
+    }
+
     // 行协议：按 '\n' 拆包，剥掉末尾 '\r'
-    size_t pos = 0;
-    for (;;) {
+    // 每取走一行只移动 inbuf 的读下标，不搬移剩下的数据
+    while (!conn.readPaused && !conn.closed) {
         //找到换行
-        auto nlocation = conn.inbuf.find('\n', pos);
-        //npos->not position,没找到子串/字符
-        if (nlocation == std::string::npos) {
+        const char* eol = conn.inbuf.findEOL();
+        if (eol == nullptr) {
             // 不完整，保留尚未处理的
-            conn.inbuf.erase(0, pos);
             break;  // 当前数据还不足以组成一条完整消息
         }
 
-        std::string line = conn.inbuf.substr(pos, nlocation - pos);
+        std::string line(conn.inbuf.peek(), eol);
+        conn.inbuf.retrieveUntil(eol + 1);  // 继续找下一条
         if (!line.empty() && line.back() == '\r') line.pop_back();
-        pos = nlocation + 1;  // 继续找下一条
-
-        LOG_DEBUG("[Server::onConnRead] fd=" << conn.fd
-                  << " got one line: " << line);
-
-        /*现在这个版本加入了线程池*/
-        Threadpool_->Enqueue([this, fd = conn.fd, line]() {
-            Connection* c = nullptr;
-            {
-                std::lock_guard<std::mutex> lock(conns_mtx_);
-                auto it = conns_.find(fd);
-                if (it == conns_.end()) {
-                    //表示连接关闭
-                    LOG_ERROR("[Server::worker] fd=" << fd
-                              << " not found in conns_ (maybe closed)");
-                    return;
-                }
-                c = it->second.get();
-            }
 
-            // 业务处理（耗时部分）
-            LOG_DEBUG("[Server::worker] handling line for fd=" << fd
-                      << " content: " << line);
+        LOGF_DEBUG("[Server::onConnRead] fd={} got one line: {}", conn.fd, line);
 
-            std::string out = msgHandler_.handleMessage(*c, line);
+        if (chat::isPing(chat::OP_TEXT, line.data(), line.size()) &&
+            replyPong(loop, conn, chat::OP_TEXT)) {
+            continue;
+        }
+        dispatchRequest(loop, connPtr, chat::OP_TEXT, std::move(line));
+    }
+}
 
-            bool isClose = false;
-            bool isBroadcast = false;
-            int  roomId  = c->roomId;
+/*把一条完整的请求交给线程池处理；op 为 OP_TEXT 时 body 是一行 JSON，否则是二进制帧的 payload*/
+void Server::dispatchRequest(IoLoop& loop, const ConnectionPtr& connPtr, uint8_t op,
+                             std::string body) {
+    Connection& conn = *connPtr;
 
-            try {
-                json resp = json::parse(out);
-                isClose   = resp.value("close", false);
-                isBroadcast = resp.value("broadcast", false);
-                roomId = resp.value("roomId", roomId);
+    // 全服在途请求已经过了高水位：不排队了，马上告诉客户端忙，别让队列越积越长
+    if (inflight_.load(std::memory_order_relaxed) >= busyHighWater_) {
+        rejectBusy(loop, connPtr, op);
+        return;
+    }
 
-            } catch (const std::exception& e) {
-                LOG_ERROR("[Server::worker] json parse error on response for fd="
-                          << fd << ": " << e.what());
-            }
-            if (isBroadcast) {
-                broadcastToRoom(roomId, out);
+    /*现在这个版本加入了线程池*/
+    /*任务里直接带上连接的 shared_ptr：业务线程不用再去查 conns（那是 loop 线程私有的），
+    连接就算这时被关掉，对象也还活着，写回时由 loop 线程看 closed 决定丢弃。
+    经连接自己的 strand 投递：同一连接的请求按顺序、一次一个地处理，流水线发来的请求回包不会乱序*/
+    Task task([this, lp = &loop, c = connPtr, fd = connPtr->fd, op,
+               body = std::move(body)]() {
+        // 不管中途从哪里返回（包括抛异常），都要把在途计数还回去
+        struct Done {
+            Server* s; IoLoop* lp; const ConnectionPtr& c;
+            ~Done() { s->finishRequest(*lp, c); }
+        } done{this, lp, c};
+
+        if (c->closed) {
+            //表示连接关闭
+            LOG_ERROR("[Server::worker] fd=" << fd
+                      << " already closed, drop request");
+            return;
+        }
+
+        // 业务处理（耗时部分）
+        HandlerResult result;
+        if (op == chat::OP_TEXT) {
+            LOGF_DEBUG("[Server::worker] handling line for fd={} content: {}", fd, body);
+            result = msgHandler_.handleLine(*c, body);
+        } else {
+            json req;
+            if (chat::decodeRequest(op, body, req)) {
+                result = msgHandler_.handleRequest(*c, req);
             } else {
-            // 写回事件一定要在 Server 线程安全里做
-            postWrite(fd, std::move(out));
+                result.body["ok"]  = false;
+                result.body["err"] = "bad frame";
             }
-            
-            if (isClose) {
-                std::lock_guard<std::mutex> lock(conns_mtx_);
-                auto it = conns_.find(fd);
-                if (it != conns_.end()) {
-                    it->second->shortClose.store(true);
-                    LOG_DEBUG("[Server::worker] fd=" << fd
-                              << " marked shortClose=true (will close after write)");
-                }
-            }
-        });
+        }
+
+        // 按业务返回的路由投递，不用再去回包里找 close / broadcast
+        const json& resp = result.body;
+        if (result.route == HandlerResult::Route::Broadcast) {
+            // 两种协议各编码一次，房间里所有人共享
+            broadcastToRoom(result.roomId, chat::encodeTextLine(resp),
+                            chat::encodeChatFrame(resp));
+            return;
+        }
+
+        std::string out = (c->proto == WireProtocol::Binary)
+                              ? chat::encodeBinaryResponse(op, resp)
+                              : chat::encodeTextLine(resp);
+        // 写回事件一定要交给连接所属的 loop 线程去做
+        postWrite(*lp, c, std::move(out),
+                  result.route == HandlerResult::Route::ReplyThenClose);
+    });
+
+    inflight_.fetch_add(1, std::memory_order_relaxed);
+    int connInflight = conn.inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // loop 线程里绝不阻塞：线程池满了就当过载处理
+    if (!conn.strand->tryPost(task)) {
+        inflight_.fetch_sub(1, std::memory_order_relaxed);
+        conn.inflight.fetch_sub(1, std::memory_order_relaxed);
+        rejectBusy(loop, connPtr, op);
+        return;
+    }
+
+    if (connInflight >= kMaxConnInflight && !conn.readPaused) {
+        pauseReading(loop, conn);
+    }
+}
+
+void Server::finishRequest(IoLoop& loop, const ConnectionPtr& conn) {
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+    // 连接自己的在途数交给 loop 线程去扣：这个请求的回包是先 runInLoop 排进 loop 的，
+    // 这个任务排在它后面，轮到时回包一定已经进了 outbuf（或者已经写出去了）。
+    // 所以 loop 线程看到 inflight == 0 时前面的回包都排好了，pong / server busy 直接回不会插队
+    loop.rt->runInLoop([this, lp = &loop, conn]() {
+        // 暂停读之后在途数只减不增，正好降到低水位的那一次负责恢复读
+        if (conn->inflight.fetch_sub(1, std::memory_order_acq_rel) - 1 == kResumeConnInflight) {
+            resumeReading(*lp, conn);
+        }
+    });
+}
+
+void Server::rejectBusy(IoLoop& loop, const ConnectionPtr& connPtr, uint8_t op) {
+    Connection& conn = *connPtr;
+    uint64_t n = rejected_.fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((n & (n - 1)) == 0) {
+        // 第 1、2、4、8... 次打一条，过载时别把日志也打爆
+        LOG_WARN("[Server::dispatchRequest] server busy, inflight="
+                 << inflight_.load(std::memory_order_relaxed)
+                 << " highWater=" << busyHighWater_ << " rejected=" << n);
+    }
+
+    // 所有连接共用同一份编码好的回包
+    static const json busy = {{"ok", false}, {"err", "server busy"}};
+    static const Slice busyText = std::make_shared<const std::string>(chat::encodeTextLine(busy));
+    Slice reply = (conn.proto == WireProtocol::Binary)
+                      ? std::make_shared<const std::string>(chat::encodeBinaryResponse(op, busy))
+                      : busyText;
+
+    // inflight 为 0：前面的回包都已经进了 outbuf（见 finishRequest），直接回不会插队
+    if (conn.inflight.load(std::memory_order_relaxed) == 0) {
+        sendInLoop(loop, conn, reply, false);
+        return;
+    }
+
+    // 前面还有请求没回：和 replyPong 一样不能插队，排进 strand 跟在它们后面回。
+    // 算一个在途请求，免得后面的 pong / busy 又抢到它前面
+    Task task([this, lp = &loop, c = connPtr, reply]() {
+        struct Done {
+            Server* s; IoLoop* lp; const ConnectionPtr& c;
+            ~Done() { s->finishRequest(*lp, c); }
+        } done{this, lp, c};
+        lp->rt->runInLoop([this, lp, c, reply]() { sendInLoop(*lp, *c, reply, false); });
+    });
+    inflight_.fetch_add(1, std::memory_order_relaxed);
+    int connInflight = conn.inflight.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (connInflight >= kMaxConnInflight && !conn.readPaused) pauseReading(loop, conn);
+    if (conn.strand->tryPost(task)) return;
+    inflight_.fetch_sub(1, std::memory_order_relaxed);
+
+    // strand 刚好空闲下来（要重新往线程池投排空任务）而线程池又满了：
+    // strand 空闲说明前面的请求都跑完了，回包都已经排进了 loop 的任务队列，
+    // 这条 busy 也排进去（不能用 runInLoop，那会当场执行），轮到它时前面的都发出去了。
+    // 在途数同样等它进了 outbuf 才扣
+    loop.rt->queueInLoop([this, lp = &loop, c = connPtr, reply]() {
+        sendInLoop(*lp, *c, reply, false);
+        if (c->inflight.fetch_sub(1, std::memory_order_acq_rel) - 1 == kResumeConnInflight) {
+            resumeReading(*lp, c);
+        }
+    });
+}
+
+void Server::pauseReading(IoLoop& loop, Connection& conn) {
+    conn.readPaused = true;
+    readPauses_.fetch_add(1, std::memory_order_relaxed);
+    updateEvents(loop, conn);
+    LOG_WARN("[Server::pauseReading] fd=" << conn.fd << " too many in-flight requests ("
+             << conn.inflight.load(std::memory_order_relaxed) << "), pause reading");
+}
+
+void Server::resumeReading(IoLoop& loop, const ConnectionPtr& connPtr) {
+    Connection& conn = *connPtr;
+    if (conn.closed || !conn.readPaused || loop.draining) return;
+    conn.readPaused = false;
+    LOG_INFO("[Server::resumeReading] fd=" << conn.fd << " resume reading, inflight="
+             << conn.inflight.load(std::memory_order_relaxed));
+
+    // 先把暂停时已经读进 inbuf 的请求处理掉（可能又会暂停）
+    processInput(loop, connPtr);
+    // 重新挂上 EPOLLIN：MOD 会重新评估就绪状态，内核里攒着的数据（ET 模式也一样）会再报一次
+    if (!conn.closed && !conn.readPaused) updateEvents(loop, conn);
+}
+
+bool Server::replyPong(IoLoop& loop, Connection& conn, uint8_t op) {
+    conn.heartbeat = true;
+    pings_.fetch_add(1, std::memory_order_relaxed);
+    // 前面还有请求没回：pong 不能插队，和普通请求一样排进 strand。
+    // inflight 是在回包排进 loop 之后才在 loop 线程里扣的（见 finishRequest），为 0 就说明前面的都排好了
+    if (conn.inflight.load(std::memory_order_relaxed) > 0) return false;
+
+    // 回包是固定的，编码一次所有连接共用：一次心跳只有一次 write，没有分配
+    static const Slice textPong   = std::make_shared<const std::string>(chat::encodePong(chat::OP_TEXT));
+    static const Slice binaryPong = std::make_shared<const std::string>(chat::encodePong(chat::OP_PING));
+    static const Slice jsonPong   = std::make_shared<const std::string>(chat::encodePong(chat::OP_JSON));
+    const Slice& pong = op == chat::OP_TEXT ? textPong
+                      : op == chat::OP_PING ? binaryPong
+                                            : jsonPong;
+    sendInLoop(loop, conn, pong, false);
+    return true;
+}
+
+void Server::sweepDeadSessions(IoLoop& loop) {
+    int64_t now = reactor::nowMs();
+    std::vector<int> dead;
+    for (const auto& kv : loop.conns) {
+        const Connection& c = *kv.second;
+        if (c.heartbeat && now - c.lastActiveMs > heartbeatTimeoutMs_) dead.push_back(kv.first);
+    }
+    // closeConn 会改 conns，先收集再关
+    for (int fd : dead) {
+        LOG_INFO("[Server::sweepDeadSessions] fd=" << fd << " missed heartbeats, closing");
+        closeConn(fd);
     }
+    if (!dead.empty()) {
+        deadSessions_.fetch_add(dead.size(), std::memory_order_relaxed);
+    }
+}
+
+void Server::onOutputHighWater(Connection& conn, size_t bytes) {
+    conn.slowConsumer = true;
+    slowConsumers_.fetch_add(1, std::memory_order_relaxed);
+    LOG_WARN("[Server::onOutputHighWater] fd=" << conn.fd << " user=" << conn.userId.load()
+             << " has " << bytes << " bytes queued, pause broadcasts");
+}
+
+void Server::onOutputLowWater(Connection& conn, size_t bytes) {
+    conn.slowConsumer = false;
+    slowConsumers_.fetch_sub(1, std::memory_order_relaxed);
+    LOG_INFO("[Server::onOutputLowWater] fd=" << conn.fd << " user=" << conn.userId.load()
+             << " drained to " << bytes << " bytes, resume broadcasts");
+}
+
+void Server::reportOutputBacklog(IoLoop& loop) {
+    size_t total = 0;
+    std::vector<ConnBacklog> backlog;
+    std::vector<std::pair<size_t, const Connection*>> lagging;
+    for (const auto& kv : loop.conns) {
+        const Connection& c = *kv.second;
+        size_t bytes = c.outbuf.bytes();
+        total += bytes;
+        if (bytes == 0) continue;
+        backlog.push_back(ConnBacklog{c.fd, c.id, c.userId.load(), bytes, c.slowConsumer});
+        if (bytes > outputLowWater_) lagging.emplace_back(bytes, &c);
+    }
+    loop.queuedBytes.store(total, std::memory_order_relaxed);
+    std::sort(backlog.begin(), backlog.end(),
+              [](const ConnBacklog& a, const ConnBacklog& b) { return a.queuedBytes > b.queuedBytes; });
+    {
+        std::lock_guard<std::mutex> lock(loop.backlogMtx);
+        loop.backlog.swap(backlog);
+    }
+    if (lagging.empty()) return;
+
+    // 只打积压最多的几个，连接多的时候日志不至于刷屏
+    size_t top = std::min<size_t>(lagging.size(), kBacklogReportTop);
+    std::partial_sort(lagging.begin(), lagging.begin() + top, lagging.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+    for (size_t i = 0; i < top; ++i) {
+        const Connection& c = *lagging[i].second;
+        LOG_WARN("[Server::reportOutputBacklog] fd=" << c.fd << " user=" << c.userId.load()
+                 << " queued=" << lagging[i].first << " bytes"
+                 << (c.slowConsumer ? " (slow)" : ""));
+    }
+    if (lagging.size() > top) {
+        LOG_WARN("[Server::reportOutputBacklog] " << lagging.size() - top
+                 << " more connections above low water, total queued=" << total);
+    }
+}
+
+void Server::updateEvents(IoLoop& loop, Connection& conn) {
+    uint32_t events = (conn.readPaused ? 0u : static_cast<uint32_t>(EPOLLIN))
+                    | (conn.wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    loop.rt->modFd(conn.fd, events, nullptr);
+}
+
+Server::Stats Server::stats() const {
+    Stats st;
+    st.inflight   = inflight_.load(std::memory_order_relaxed);
+    st.poolQueued = Threadpool_ ? Threadpool_->pendingTasks() : 0;
+    st.rejected   = rejected_.load(std::memory_order_relaxed);
+    st.readPauses = readPauses_.load(std::memory_order_relaxed);
+    st.pings        = pings_.load(std::memory_order_relaxed);
+    st.deadSessions = deadSessions_.load(std::memory_order_relaxed);
+    st.slowConsumers     = slowConsumers_.load(std::memory_order_relaxed);
+    st.droppedBroadcasts = droppedBroadcasts_.load(std::memory_order_relaxed);
+    st.evictedSlow       = evictedSlow_.load(std::memory_order_relaxed);
+    st.outputBytes = 0;
+    for (const auto& lp : loops_) {
+        st.outputBytes += lp->queuedBytes.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(lp->backlogMtx);
+        st.backlog.insert(st.backlog.end(), lp->backlog.begin(), lp->backlog.end());
+    }
+    std::sort(st.backlog.begin(), st.backlog.end(),
+              [](const ConnBacklog& a, const ConnBacklog& b) { return a.queuedBytes > b.queuedBytes; });
+    return st;
 }
 
 // 将 outbuf 中的数据尽可能写入客户端 socket（触发 TCP 发送）
 void Server::onConnWrite(Connection& c) {
     for (;;) {
         if (c.outbuf.empty()) break;
-        ssize_t n = ::write(c.fd, c.outbuf.data(), c.outbuf.size());
+        int savedErrno = 0;
+        // writev：排队的多条回包一次系统调用写出去，不用先拼成一整块
+        ssize_t n = c.outbuf.writeFd(c.fd, &savedErrno);
         if (n > 0) {
-            LOG_DEBUG("[Server::onConnWrite] fd=" << c.fd
-                      << " wrote " << n << " bytes, left=" << (c.outbuf.size() - n));
-            c.outbuf.erase(0, static_cast<size_t>(n));
+            LOGF_DEBUG("[Server::onConnWrite] fd={} wrote {} bytes, left={}",
+                       c.fd, n, c.outbuf.bytes());
             continue;
         }
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
             // 还能写下次再来
-            LOG_DEBUG("[Server::onConnWrite] fd=" << c.fd
-                      << " cannot write more now (EAGAIN/EWOULDBLOCK)");
+            LOGF_DEBUG("[Server::onConnWrite] fd={} cannot write more now (EAGAIN/EWOULDBLOCK)",
+                       c.fd);
             break;
         }
-        perror("write");
         LOG_ERROR("[Server::onConnWrite] write error on fd=" << c.fd
-                  << ": " << strerror(errno));
+                  << ": " << strerror(savedErrno));
         closeConn(c.fd);
         return;
     }
@@ -377,73 +934,126 @@ void Server::onConnWrite(Connection& c) {
         LOG_INFO("[Server::onConnWrite] fd=" << c.fd
                  << " outbuf empty and shortClose=true, closing");
         closeConn(c.fd);
+        return;
     }
 
     if (c.outbuf.empty() && c.wantWrite) {
         c.wantWrite.store(false);
-        // 只保留读事件（user 传 nullptr 表示不改）
-        reactor_.modFd(c.fd, EPOLLIN, nullptr);
-        LOG_DEBUG("[Server::onConnWrite] fd=" << c.fd
-                  << " write finished, disable EPOLLOUT");
+        // 摘掉 EPOLLOUT（暂停读的连接也不会把 EPOLLIN 加回来）
+        updateEvents(loopOf(c.fd), c);
+        LOGF_DEBUG("[Server::onConnWrite] fd={} write finished, disable EPOLLOUT", c.fd);
     }
 }
 
 /*关闭客户端的连接*/
 void Server::closeConn(int fd) {
-    int roomId = 0;
-    bool authed = false;
-
-    {
-        std::lock_guard<std::mutex> lock(conns_mtx_);
-        auto it = conns_.find(fd);
-        if (it == conns_.end()) {
-            LOG_ERROR("[Server::closeConn] fd=" << fd << " not found in conns_");
-            return;
-        }
-        // 先把信息记下来，后面锁外用
-        roomId = it->second->roomId;
-        authed = it->second->authed;
+    // 只会在连接所属的 loop 线程里被调用
+    IoLoop& loop = loopOf(fd);
+    auto it = loop.conns.find(fd);
+    if (it == loop.conns.end()) {
+        LOG_ERROR("[Server::closeConn] fd=" << fd << " not found in conns");
+        return;
     }
+    // 先从 conns 里摘掉，再 close：close 之后 fd 号随时可能被新连接复用
+    ConnectionPtr conn = std::move(it->second);
+    loop.conns.erase(it);
 
     LOG_INFO("[Server::closeConn] closing fd=" << fd);
 
-    reactor_.delFd(fd);
-    ::close(fd);
-    // 锁外更新房间人数，避免锁嵌套
-    if (authed) {
-        RoomManager::Instance().leaveRoom(roomId);
+    conn->closed.store(true);   // 标记已关闭，之后投递过来的写回都会被丢弃
+    if (conn->slowConsumer) {
+        conn->slowConsumer = false;
+        slowConsumers_.fetch_sub(1, std::memory_order_relaxed);
     }
-
-    {
-        std::lock_guard<std::mutex> lock(conns_mtx_);
-        conns_.erase(fd);
+    conn->outbuf.clear();   // 积压的数据没用了，早点把共享的广播块放掉
+    if (conn->idleTimer != 0) {
+        loop.rt->cancel(conn->idleTimer);
+        conn->idleTimer = 0;
     }
+    loop.rt->delFd(fd);
+    ::close(fd);
+
+    // 必须在 closed.store(true) 之后读：worker 可能正在 strand 上登录 / 换房间，
+    // 当前房间和正在进的房间都退一遍（成员不在房间里时 leaveRoom 什么也不做），见 enterRoom
+    RoomMember member{fd, conn->id};
+    int roomId    = conn->roomId.load();
+    int joiningId = conn->joiningRoomId.load();
+    if (roomId > 0) RoomManager::Instance().leaveRoom(roomId, member);
+    if (joiningId > 0 && joiningId != roomId) RoomManager::Instance().leaveRoom(joiningId, member);
 }
 
 
-/*把服务端想写的通过多线程先放在Connect里的outbuf*/
-void Server::postWrite(int fd, std::string data) {
-    std::unique_lock<std::mutex> lk(conns_mtx_);
-    auto it = conns_.find(fd);
-    if (it == conns_.end()) {
-        LOG_ERROR("[Server::postWrite] fd=" << fd << " not found in conns_");
+/*把服务端想写的打包成任务交给连接所属的 loop，
+由 loop 线程放进 Connect 里的 outbuf（业务线程不碰 outbuf，也不调 epoll_ctl）*/
+void Server::postWrite(IoLoop& loop, const ConnectionPtr& conn, std::string data,
+                       bool closeAfter) {
+    Slice payload = std::make_shared<const std::string>(std::move(data));
+    loop.rt->runInLoop([this, lp = &loop, conn, payload = std::move(payload), closeAfter]() {
+        sendInLoop(*lp, *conn, payload, closeAfter);
+    });
+}
+
+void Server::sendInLoop(IoLoop& loop, Connection& c, const Slice& data,
+                        bool closeAfter) {
+    if (c.closed) {
+        LOG_DEBUG("[Server::sendInLoop] fd=" << c.fd << " already closed, drop "
+                  << data->size() << " bytes");
         return; // 连接已关
     }
-    Connection& c = *it->second;
 
-    LOG_DEBUG("[Server::postWrite] fd=" << fd
-              << " append " << data.size() << " bytes to outbuf");
+    /*快路径：outbuf 是空的、也没在等 EPOLLOUT，说明 socket 发送缓冲区大概率有空间，
+    直接 write 一次。一个 ~100 字节的 JSON 回包基本一次就写完了，
+    不用 modFd 打开 EPOLLOUT、再等 onConnWrite、再 modFd 关掉。*/
+    size_t written = 0;
+    if (!c.wantWrite && c.outbuf.empty()) {
+        ssize_t n = ::write(c.fd, data->data(), data->size());
+        if (n >= 0) {
+            written = static_cast<size_t>(n);
+            LOGF_DEBUG("[Server::sendInLoop] fd={} direct write {} / {} bytes",
+                       c.fd, n, data->size());
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            LOG_ERROR("[Server::sendInLoop] write error on fd=" << c.fd
+                      << ": " << strerror(errno));
+            closeConn(c.fd);
+            return;
+        }
+    }
 
-    c.outbuf.append(data);
+    if (written == data->size()) {
+        // 全部写完：不碰 epoll
+        if (closeAfter) {
+            LOG_INFO("[Server::sendInLoop] fd=" << c.fd
+                     << " reply flushed and close requested, closing");
+            closeConn(c.fd);
+        }
+        return;
+    }
+
+    LOGF_DEBUG("[Server::sendInLoop] fd={} append {} bytes to outbuf",
+               c.fd, data->size() - written);
+
+    // 只把没写出去的部分挂进 outbuf（引用同一块数据 + 偏移，不拷贝），交给 EPOLLOUT 慢慢写
+    c.outbuf.append(data, written);
+    if (maxOutputBytes_ > 0 && c.outbuf.bytes() > maxOutputBytes_) {
+        // 高水位之后只会再收到它自己请求的回包，还能涨到这里说明对方基本不读了
+        LOG_WARN("[Server::sendInLoop] fd=" << c.fd << " user=" << c.userId.load()
+                 << " queued " << c.outbuf.bytes() << " bytes (limit "
+                 << maxOutputBytes_ << "), disconnect slow consumer");
+        evictedSlow_.fetch_add(1, std::memory_order_relaxed);
+        closeConn(c.fd);
+        return;
+    }
+    if (closeAfter) {
+        c.shortClose.store(true);
+        LOG_DEBUG("[Server::sendInLoop] fd=" << c.fd
+                  << " marked shortClose=true (will close after write)");
+    }
     if (!c.wantWrite) {
         c.wantWrite.store(true);
-        LOG_DEBUG("[Server::postWrite] fd=" << fd
-                  << " enable EPOLLOUT and wakeup reactor");
-        // 正确顺序：先改 epoll 事件，再唤醒 reactor
-        reactor_.modFd(fd, EPOLLIN | EPOLLOUT, &c);
-        reactor_.wakeup();
+        LOGF_DEBUG("[Server::sendInLoop] fd={} enable EPOLLOUT", c.fd);
+        // 已经在 loop 线程里了，改完 epoll 事件，下一轮 epoll_wait 就会报 EPOLLOUT，不用再 wakeup
+        updateEvents(loop, c);
     }
-    // 锁在作用域末尾释放
 }
 
 bool Server::setNonBlock(int fd) {
@@ -476,22 +1086,41 @@ bool Server::setTcpNoDelay(int fd) {
 
 
 //按房间广播
-void Server::broadcastToRoom(int roomId, const std::string& data){
-    // 1) 先在锁内拿出所有需要广播的 fd，避免在持锁期间调用 postWrite（postWrite 自己也要锁）
-    std::vector<int> targets;
+void Server::broadcastToRoom(int roomId, std::string text, std::string binary){
+    // 从房间索引里拿成员快照：只碰这个房间的人，不再扫描全服连接，也不挡别人进出房间
+    RoomManager::MemberSnapshot members = RoomManager::Instance().members(roomId);
+    if (!members || members->empty()) return;
 
-    {
-        std::lock_guard<std::mutex> lock(conns_mtx_);
-        for(auto& kv : conns_){
-            Connection* c = kv.second.get();
-            if(!c->authed) continue;
-            if(c->roomId != roomId) continue;
-            targets.push_back(c->fd);
-        }         
+    // 每种协议的消息只编码、分配一次，所有目标连接的 outbuf 都引用同一份
+    Slice textPayload   = std::make_shared<const std::string>(std::move(text));
+    Slice binaryPayload = std::make_shared<const std::string>(std::move(binary));
+
+    // 按成员所属的 loop 分组，每个 loop 只投递一个任务
+    std::vector<std::vector<RoomMember>> perLoop(loops_.size());
+    for (const auto& m : *members) {
+        perLoop[static_cast<size_t>(m.fd) % loops_.size()].push_back(m);
     }
 
-    // 2) 锁外循环调用 postWrite（内部自己会上锁、改 EPOLLOUT）
-    for(int fd : targets){
-        postWrite(fd, data);
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        if (perLoop[i].empty()) continue;
+        IoLoop* loop = loops_[i].get();
+        loop->rt->runInLoop([this, loop, targets = std::move(perLoop[i]),
+                             textPayload, binaryPayload]() {
+            for (const auto& m : targets) {
+                auto it = loop->conns.find(m.fd);
+                // fd 可能已经关了，或者被新连接复用了（connId 对不上）
+                if (it == loop->conns.end()) continue;
+                ConnectionPtr c = it->second;
+                if (c->id != m.connId || !c->authed) continue;
+                // 慢消费者先不推广播（聊天消息丢了可以再拉历史），自己请求的回包照常排队
+                if (c->slowConsumer) {
+                    droppedBroadcasts_.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                const Slice& payload =
+                    (c->proto == WireProtocol::Binary) ? binaryPayload : textPayload;
+                sendInLoop(*loop, *c, payload, false);   // 只增加引用计数
+            }
+        });
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,52 @@
+#include "core/Strand.h"
+#include "core/ThreadPool.h"
+#include "core/Logger.h"
+
+void Strand::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        queue_.push(std::move(task));
+        if (running_) return;   // 已经有 drain 在跑或在排队，会顺带处理它
+        running_ = true;
+    }
+    // 之前是空闲的：由我们负责启动一次排空
+    pool_.Enqueue([self = shared_from_this()]() { self->drain(); });
+}
+
+bool Strand::tryPost(Task& task) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_) {
+        // 先把排空任务放进线程池，放不进去就什么都不改；
+        // 排空任务就算马上被 worker 拿走，也会先卡在 mtx_ 上，等我们把 task 放好
+        Task kick([self = shared_from_this()]() { self->drain(); });
+        if (!pool_.TryEnqueue(kick)) return false;
+        running_ = true;
+    }
+    queue_.push(std::move(task));
+    return true;
+}
+
+void Strand::drain() {
+    Task task;
+    for (int n = 0; n < kMaxBatch; ++n) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (!queue_.pop(task)) {
+                running_ = false;   // 排空了，下一个 post 重新启动
+                return;
+            }
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("[Strand::drain] exception in task: " << e.what());
+        } catch (...) {
+            LOG_ERROR("[Strand::drain] unknown exception in task");
+        }
+        task.reset();   // 尽早放掉捕获的连接
+    }
+
+    // 跑满一批还有活：重新排队，让别的连接也有机会（running_ 保持 true）
+    pool_.Enqueue([self = shared_from_this()]() { self->drain(); });
+}
@@ -1,72 +1,222 @@
 #include "core/ThreadPool.h"
 #include "core/Logger.h"   // 新增：日志头文件
 #include <thread>
+#include <algorithm>
+#include <vector>
+
+namespace {
+// 每次从全局队列最多搬多少个任务到自己的队列
+constexpr size_t kGlobalBatch = 32;
+
+// maxCount <= 0（不限）时全局队列用的容量
+constexpr size_t kUnboundedCapacity = 65536;
+
+// 每个线程最多缓存多少个空闲任务节点
+constexpr size_t kNodeCacheSize = 256;
+
+// 当前线程是哪个池的第几个 worker（不是 worker 时 pool 为空）
+thread_local const ThreadPool* t_pool  = nullptr;
+thread_local size_t            t_index = 0;
+
+// 挑偷窃对象用的随机数（xorshift，每个线程一份，不需要同步）
+uint32_t nextRandom() {
+    thread_local uint32_t state =
+        static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// 线程本地的空闲任务节点：worker 既搬运任务（要节点）也执行任务（还节点），基本能自给自足
+struct NodeCache {
+    std::vector<Task*> free;
+    ~NodeCache() {
+        for (Task* t : free) delete t;
+    }
+};
+thread_local NodeCache t_nodes;
+}
+
+Task* ThreadPool::acquireNode(Task&& task) {
+    auto& free = t_nodes.free;
+    if (free.empty()) return new Task(std::move(task));
+    Task* node = free.back();
+    free.pop_back();
+    *node = std::move(task);
+    return node;
+}
+
+void ThreadPool::releaseNode(Task* node) {
+    node->reset();   // 先把捕获的东西（连接的 shared_ptr 之类）放掉
+    auto& free = t_nodes.free;
+    if (free.size() < kNodeCacheSize) {
+        free.push_back(node);
+    } else {
+        delete node;
+    }
+}
 
 ThreadPool::ThreadPool(size_t threadCount, int maxCount)
-    : stop_(false), tasks_(maxCount)
+    : stop_(false), threadCount_(threadCount == 0 ? 1 : threadCount),
+      inject_(maxCount > 0 ? static_cast<size_t>(maxCount) : kUnboundedCapacity)
 {
-    workers_.reserve(threadCount);
+    workers_.reserve(threadCount_);
+    for (size_t i = 0; i < threadCount_; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
     LOG_INFO("[ThreadPool::ThreadPool] create thread pool, threads="
-             << threadCount << ", maxTasks=" << maxCount);
+             << threadCount_ << ", maxTasks=" << maxCount);
 }
 
 ThreadPool::~ThreadPool() {
     LOG_INFO("[ThreadPool::~ThreadPool] stopping thread pool...");
 
-    // 通知工作线程退出
+    // 通知工作线程退出（手上和队列里剩下的任务会先跑完）
     stop_ = true;
-    tasks_.Stop();
+    inject_.Stop();   // 叫醒因为队列满卡在 Enqueue 里的生产者
+    idle_.notifyAll();
 
     // 等待所有线程结束
-    for (auto& t : workers_) {
-        if (t.joinable()) {
+    for (auto& w : workers_) {
+        if (w->th.joinable()) {
             LOG_DEBUG("[ThreadPool::~ThreadPool] joining worker thread "
-                      << t.get_id());
-            t.join();
+                      << w->th.get_id());
+            w->th.join();
         }
     }
 
+    // 没启动过 worker（没调 run）时队列里可能还有任务，释放掉
+    Task leftover;
+    while (inject_.tryPop(leftover)) leftover.reset();
+    for (auto& w : workers_) {
+        while (Task* t = w->deque.steal()) delete t;
+    }
+
     LOG_INFO("[ThreadPool::~ThreadPool] all worker threads joined");
 }
 
-void ThreadPool::Enqueue(std::function<void()> task) {
-    // 将任务放入安全队列
-    if (!tasks_.Safepush(std::move(task))) {
+void ThreadPool::Enqueue(Task task) {
+    if (stop_) {
         LOG_ERROR("[ThreadPool::Enqueue] push task failed (queue stopped?)");
-    } else {
-        // 这里日志可以视情况注释掉，任务多的话会比较吵
-        LOG_DEBUG("[ThreadPool::Enqueue] task enqueued");
+        return;
     }
+
+    if (t_pool == this) {
+        // worker 自己提交的任务：压进自己的队列，无锁；别的 worker 闲着会来偷
+        workers_[t_index]->deque.push(acquireNode(std::move(task)));
+    } else if (!inject_.Safepush(std::move(task))) {
+        LOG_ERROR("[ThreadPool::Enqueue] push task failed (queue stopped?)");
+        return;
+    }
+
+    // 这里日志可以视情况注释掉，任务多的话会比较吵
+    LOGF_DEBUG("[ThreadPool::Enqueue] task enqueued");
+    idle_.notifyOne();
 }
 
-void ThreadPool::RunPool() {
+bool ThreadPool::TryEnqueue(Task& task) {
+    if (stop_) return false;
+
+    if (t_pool == this) {
+        workers_[t_index]->deque.push(acquireNode(std::move(task)));
+    } else if (!inject_.tryPush(std::move(task))) {
+        return false;   // 满了：tryPush 没抢到槽位时不会移走 task
+    }
+
+    LOGF_DEBUG("[ThreadPool::TryEnqueue] task enqueued");
+    idle_.notifyOne();
+    return true;
+}
+
+size_t ThreadPool::pendingTasks() const {
+    size_t n = inject_.sizeApprox();
+    for (const auto& w : workers_) {
+        n += static_cast<size_t>(w->deque.sizeApprox());
+    }
+    return n;
+}
+
+Task* ThreadPool::popGlobalBatch(size_t index) {
+    size_t pending = inject_.sizeApprox();
+    if (pending == 0) return nullptr;
+
+    // 按 worker 数平分，别一个人把全局队列全搬走
+    size_t n = std::min(kGlobalBatch, pending / threadCount_ + 1);
+    Task task;
+    if (!inject_.tryPop(task)) return nullptr;
+    Task* first = acquireNode(std::move(task));
+    for (size_t i = 1; i < n && inject_.tryPop(task); ++i) {
+        workers_[index]->deque.push(acquireNode(std::move(task)));
+    }
+    return first;
+}
+
+Task* ThreadPool::stealFromOthers(size_t index) {
+    if (threadCount_ < 2) return nullptr;
+    // 从随机位置开始轮一圈，避免大家总去偷同一个 worker
+    size_t start = nextRandom() % threadCount_;
+    for (size_t k = 0; k < threadCount_; ++k) {
+        size_t victim = (start + k) % threadCount_;
+        if (victim == index) continue;
+        if (Task* t = workers_[victim]->deque.steal()) return t;
+    }
+    return nullptr;
+}
+
+Task* ThreadPool::findTask(size_t index) {
+    if (Task* t = workers_[index]->deque.pop()) return t;
+    if (Task* t = popGlobalBatch(index))        return t;
+    return stealFromOthers(index);
+}
+
+bool ThreadPool::hasPendingWork() const {
+    if (inject_.sizeApprox() > 0) return true;
+    for (const auto& w : workers_) {
+        if (!w->deque.emptyApprox()) return true;
+    }
+    return false;
+}
+
+void ThreadPool::runTask(Task* task) {
+    LOGF_DEBUG("[ThreadPool::RunPool] worker {} got one task", t_index);
+    try {
+        (*task)();
+    } catch (const std::exception& e) {
+        LOG_ERROR("[ThreadPool::RunPool] exception in task: "
+                  << e.what());
+    } catch (...) {
+        LOG_ERROR("[ThreadPool::RunPool] unknown exception in task");
+    }
+    releaseNode(task);
+}
+
+void ThreadPool::RunPool(size_t index) {
+    t_pool  = this;
+    t_index = index;
     LOG_INFO("[ThreadPool::RunPool] worker thread "
              << std::this_thread::get_id() << " start");
 
-    while (!stop_) {
-        std::function<void()> task;
-        // Safepop 内部会阻塞等待，有任务或 Stop 后才返回
-        if (tasks_.Safepop(task)) {
-            LOG_DEBUG("[ThreadPool::RunPool] worker "
-                      << std::this_thread::get_id()
-                      << " got one task");
-            try {
-                task();
-            } catch (const std::exception& e) {
-                LOG_ERROR("[ThreadPool::RunPool] exception in task: "
-                          << e.what());
-            } catch (...) {
-                LOG_ERROR("[ThreadPool::RunPool] unknown exception in task");
-            }
-        } else {
-            // Safepop 返回 false，说明队列 stop 了
-            if (stop_) {
-                LOG_INFO("[ThreadPool::RunPool] worker "
-                         << std::this_thread::get_id()
-                         << " exits because pool stopped");
-                break;
-            }
+    for (;;) {
+        if (Task* t = findTask(index)) {
+            runTask(t);
+            continue;
+        }
+
+        // 准备睡之前再看一眼：prepareWait 之后提交的任务一定会把我们叫醒
+        uint32_t key = idle_.prepareWait();
+        if (hasPendingWork()) {
+            idle_.cancelWait();
+            continue;
+        }
+        if (stop_) {
+            idle_.cancelWait();
+            LOG_INFO("[ThreadPool::RunPool] worker "
+                     << std::this_thread::get_id()
+                     << " exits because pool stopped");
+            break;
         }
+        idle_.commitWait(key);
     }
 
     LOG_INFO("[ThreadPool::RunPool] worker thread "
@@ -75,13 +225,13 @@ void ThreadPool::RunPool() {
 
 void ThreadPool::run() {
     LOG_INFO("[ThreadPool::run] starting workers, count="
-             << workers_.capacity());
+             << threadCount_);
 
-    for (size_t i = 0; i < workers_.capacity(); ++i) {
-        workers_.emplace_back([this]() {
-            RunPool();
+    for (size_t i = 0; i < threadCount_; ++i) {
+        workers_[i]->th = std::thread([this, i]() {
+            RunPool(i);
         });
         LOG_DEBUG("[ThreadPool::run] worker " << i
-                  << " started, id=" << workers_.back().get_id());
+                  << " started, id=" << workers_[i]->th.get_id());
     }
 }
@@ -0,0 +1,179 @@
+#include "core/TimerWheel.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <exception>
+
+TimerWheel::TimerWheel(int64_t tickMs)
+    : tickMs_(tickMs > 0 ? tickMs : 1)
+{
+}
+
+TimerWheel::~TimerWheel() {
+    for (auto& kv : timers_) delete kv.second;
+}
+
+uint64_t TimerWheel::tickOf(int64_t ms) const {
+    if (ms <= startMs_) return 0;
+    // 向上取整：宁可晚一点点触发，也不能早
+    return static_cast<uint64_t>((ms - startMs_ + tickMs_ - 1) / tickMs_);
+}
+
+void TimerWheel::add(TimerId id, int64_t nowMs, int64_t delayMs, int64_t intervalMs,
+                     Callback cb) {
+    if (startMs_ < 0) startMs_ = nowMs;
+
+    Node* node = new Node;
+    node->id         = id;
+    node->intervalMs = intervalMs;
+    node->cb         = std::move(cb);
+    // 至少放到下一个 tick：当前 tick 的槽可能已经处理过了
+    node->expireTick = std::max(tickOf(nowMs + std::max<int64_t>(delayMs, 0)), currentTick_ + 1);
+
+    auto res = timers_.emplace(id, node);
+    if (!res.second) {
+        LOG_ERROR("[TimerWheel::add] duplicated timer id=" << id);
+        delete node;
+        return;
+    }
+    place(node);
+}
+
+void TimerWheel::place(Node* node) {
+    uint64_t diff = node->expireTick - currentTick_;
+    int level = 0;
+    // 找到能装下这个距离的最低一层
+    while (level < kLevels - 1 && diff >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    uint64_t expire = node->expireTick;
+    if (level == kLevels - 1 && diff >= (uint64_t{1} << (kSlotBits * kLevels))) {
+        // 超出整个轮子的范围：先挂在最高层最远的槽，转下来时再重新计算
+        expire = currentTick_ + (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+    }
+    Slot& slot = wheel_[level][(expire >> (kSlotBits * level)) & kSlotMask];
+
+    Node* head  = &slot.head;
+    node->prev  = head->prev;
+    node->next  = head;
+    head->prev->next = node;
+    head->prev  = node;
+}
+
+void TimerWheel::unlink(Node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    auto it = timers_.find(id);
+    if (it == timers_.end()) return false;
+
+    Node* node = it->second;
+    if (node->detached) {
+        // 在正在到期的这一批里（自己的回调里取消，或者同一 tick 前面的回调取消它）：
+        // 节点已经不在槽里了，只打标记，由 expireCurrent 跳过并释放
+        node->cancelled = true;
+        return true;
+    }
+    unlink(node);
+    timers_.erase(it);
+    delete node;
+    return true;
+}
+
+void TimerWheel::cascade(int level) {
+    Slot& slot = wheel_[level][(currentTick_ >> (kSlotBits * level)) & kSlotMask];
+    // 整个链表摘下来，逐个按新的距离重新放（会落到更低的层）
+    Node* n = slot.head.next;
+    slot.head.prev = slot.head.next = &slot.head;
+    while (n != &slot.head) {
+        Node* next = n->next;
+        place(n);
+        n = next;
+    }
+}
+
+void TimerWheel::expireCurrent() {
+    Slot& slot = wheel_[0][currentTick_ & kSlotMask];
+    if (slot.empty()) return;
+
+    // 先把整个槽摘下来：回调里新加的定时器不会混进这一批
+    Node* n = slot.head.next;
+    Node* last = slot.head.prev;
+    slot.head.prev = slot.head.next = &slot.head;
+    last->next = nullptr;
+    // 先整批打上标记：回调里 cancel 这一批里的别的定时器时不能去动链表
+    for (Node* p = n; p; p = p->next) p->detached = true;
+
+    while (n) {
+        Node* next = n->next;
+        n->prev = n->next = nullptr;
+
+        if (n->cancelled) {
+            // 同一批前面的回调把它取消了
+            timers_.erase(n->id);
+            delete n;
+            n = next;
+            continue;
+        }
+
+        try {
+            n->cb();
+        } catch (const std::exception& e) {
+            LOG_ERROR("[TimerWheel::expireCurrent] exception in timer id=" << n->id
+                      << ": " << e.what());
+        } catch (...) {
+            LOG_ERROR("[TimerWheel::expireCurrent] unknown exception in timer id=" << n->id);
+        }
+        n->detached = false;
+
+        if (n->intervalMs > 0 && !n->cancelled) {
+            // 周期定时器：从这次应该触发的时间点往后排，不受回调耗时影响
+            uint64_t step = static_cast<uint64_t>((n->intervalMs + tickMs_ - 1) / tickMs_);
+            n->expireTick = currentTick_ + std::max<uint64_t>(step, 1);
+            place(n);
+        } else {
+            timers_.erase(n->id);
+            delete n;
+        }
+        n = next;
+    }
+}
+
+void TimerWheel::advance(int64_t nowMs) {
+    if (startMs_ < 0) {
+        startMs_ = nowMs;
+        return;
+    }
+    // 向下取整：只处理已经完整走过的 tick
+    uint64_t target = nowMs > startMs_ ? static_cast<uint64_t>((nowMs - startMs_) / tickMs_) : 0;
+    while (currentTick_ < target) {
+        ++currentTick_;
+        // 第 0 层转完一圈：从高到低把上层对应的槽降下来
+        if ((currentTick_ & kSlotMask) == 0) {
+            int top = 1;
+            while (top < kLevels - 1 &&
+                   ((currentTick_ >> (kSlotBits * top)) & kSlotMask) == 0) {
+                ++top;
+            }
+            for (int level = top; level >= 1; --level) cascade(level);
+        }
+        expireCurrent();
+    }
+}
+
+int TimerWheel::nextTimeoutMs(int64_t nowMs) const {
+    if (timers_.empty()) return -1;
+    if (startMs_ < 0) return 0;
+
+    // 在第 0 层往后找第一个非空槽；最多找到下一次 cascade（那之后上层的定时器才会降下来）
+    uint64_t ticks = 1;
+    for (; ticks < kSlots; ++ticks) {
+        uint64_t t = currentTick_ + ticks;
+        if (!wheel_[0][t & kSlotMask].empty()) break;
+        if ((t & kSlotMask) == 0) break;
+    }
+    int64_t wakeAt = startMs_ + static_cast<int64_t>(currentTick_ + ticks) * tickMs_;
+    return static_cast<int>(std::max<int64_t>(wakeAt - nowMs, 0));
+}
@@ -12,6 +12,8 @@ DBconnection::DBconnection() : SqlConn_(mysql_init(nullptr)) {
 }
 
 DBconnection::~DBconnection(){
+    // 语句要在连接关闭之前关掉
+    stmts_.clear();
     if(SqlConn_){
         LOG_INFO("[DBconnection::~DBconnection] closing MySQL connection, handle=" << SqlConn_);
         mysql_close(SqlConn_);
@@ -100,3 +102,36 @@ bool DBconnection::update(const std::string& sql){
 
     return true;
 }
+
+std::string DBconnection::escape(const std::string& s) {
+    if (!SqlConn_ || s.empty()) return s;
+
+    // mysql_real_escape_string 最多把长度扩大一倍 + 1
+    std::string out;
+    out.resize(s.size() * 2 + 1);
+    unsigned long len = mysql_real_escape_string(SqlConn_, &out[0], s.c_str(),
+                                                 static_cast<unsigned long>(s.size()));
+    out.resize(len);
+    return out;
+}
+
+PreparedStatement* DBconnection::prepare(const std::string& sql) {
+    auto it = stmts_.find(sql);
+    if (it != stmts_.end()) {
+        if (it->second->valid()) return it->second.get();
+        // 上次执行出错作废了（连接断过 / 表结构变了），重新 prepare
+        stmts_.erase(it);
+    }
+
+    if (stmts_.size() >= kMaxCachedStatements) {
+        LOG_WARN("[DBconnection::prepare] " << stmts_.size()
+                 << " cached statements on one connection, dropping them all");
+        stmts_.clear();
+    }
+
+    auto stmt = std::make_unique<PreparedStatement>(SqlConn_, sql);
+    if (!stmt->valid()) return nullptr;
+    PreparedStatement* raw = stmt.get();
+    stmts_.emplace(sql, std::move(stmt));
+    return raw;
+}
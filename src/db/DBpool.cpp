@@ -1,5 +1,11 @@
 #include "db/DBpool.h"
 #include "core/Logger.h"
+#include <chrono>
+
+namespace {
+// 连接全被借走时最多等多久，等不到返回 nullptr，别把业务线程一直卡住
+constexpr auto kGetConnTimeout = std::chrono::seconds(3);
+}
 
 DBPool& DBPool::Instance(){
     static DBPool instance;
@@ -72,8 +78,9 @@ DBConnectionPtr DBPool::getConnection(){
 
     DBConnectionPtr conn;
 
-    if (!pool_.Safepop(conn)) {
-        LOG_WARN("[DBPool::getConnection] Safepop failed (pool empty or stopped)");
+    if (!pool_.popFor(conn, kGetConnTimeout)) {
+        LOG_WARN("[DBPool::getConnection] no idle connection within timeout, poolSize="
+                 << poolSize_);
         return nullptr;
     }
 
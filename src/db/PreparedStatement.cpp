@@ -0,0 +1,226 @@
+#include "db/PreparedStatement.h"
+#include "core/Logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+bool isIntegerType(enum_field_types type) {
+    switch (type) {
+    case MYSQL_TYPE_TINY:
+    case MYSQL_TYPE_SHORT:
+    case MYSQL_TYPE_LONG:
+    case MYSQL_TYPE_INT24:
+    case MYSQL_TYPE_LONGLONG:
+    case MYSQL_TYPE_YEAR:
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
+PreparedStatement::PreparedStatement(MYSQL* conn, const std::string& sql)
+    : stmt_(conn ? mysql_stmt_init(conn) : nullptr), sql_(sql) {
+    if (!stmt_) {
+        LOG_ERROR("[PreparedStatement] mysql_stmt_init failed, sql=" << sql_);
+        return;
+    }
+    if (mysql_stmt_prepare(stmt_, sql_.c_str(), static_cast<unsigned long>(sql_.size())) != 0) {
+        LOG_ERROR("[PreparedStatement] prepare failed: " << mysql_stmt_error(stmt_)
+                  << ", sql=" << sql_);
+        mysql_stmt_close(stmt_);
+        stmt_ = nullptr;
+        return;
+    }
+
+    params_.resize(mysql_stmt_param_count(stmt_));
+    paramBinds_.resize(params_.size());
+    std::memset(paramBinds_.data(), 0, paramBinds_.size() * sizeof(MYSQL_BIND));
+    setupResult();
+    LOG_DEBUG("[PreparedStatement] prepared, params=" << params_.size()
+              << " columns=" << columns_.size() << ", sql=" << sql_);
+}
+
+PreparedStatement::~PreparedStatement() {
+    if (stmt_) mysql_stmt_close(stmt_);
+}
+
+// 按结果集的列类型准备好取值的缓冲区：整数列取成 int64_t，其它一律取成字符串
+void PreparedStatement::setupResult() {
+    MYSQL_RES* meta = mysql_stmt_result_metadata(stmt_);
+    if (!meta) return;   // 不是 SELECT
+
+    unsigned int n = mysql_num_fields(meta);
+    MYSQL_FIELD* fields = mysql_fetch_fields(meta);
+    columns_.resize(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        columns_[i].isInt = isIntegerType(fields[i].type);
+        if (!columns_[i].isInt) columns_[i].buf.resize(kInitialColumnBuffer);
+    }
+    mysql_free_result(meta);
+
+    resultBinds_.resize(n);
+    rebind_ = true;
+}
+
+bool PreparedStatement::bindResult() {
+    std::memset(resultBinds_.data(), 0, resultBinds_.size() * sizeof(MYSQL_BIND));
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        Column& col = columns_[i];
+        MYSQL_BIND& b = resultBinds_[i];
+        if (col.isInt) {
+            b.buffer_type   = MYSQL_TYPE_LONGLONG;
+            b.buffer        = &col.i;
+        } else {
+            b.buffer_type   = MYSQL_TYPE_STRING;
+            b.buffer        = col.buf.data();
+            b.buffer_length = static_cast<unsigned long>(col.buf.size());
+        }
+        b.length  = &col.length;
+        b.is_null = &col.isNull;
+        b.error   = &col.error;
+    }
+    if (mysql_stmt_bind_result(stmt_, resultBinds_.data())) {
+        fail("bind_result");
+        return false;
+    }
+    rebind_ = false;
+    return true;
+}
+
+void PreparedStatement::bindInt(unsigned idx, int64_t value) {
+    if (idx >= params_.size()) return;
+    Param& p = params_[idx];
+    p.i      = value;
+    p.isNull = 0;
+
+    MYSQL_BIND& b = paramBinds_[idx];
+    std::memset(&b, 0, sizeof(b));
+    b.buffer_type = MYSQL_TYPE_LONGLONG;
+    b.buffer      = &p.i;
+    b.is_null     = &p.isNull;
+}
+
+void PreparedStatement::bindString(unsigned idx, const std::string& value) {
+    if (idx >= params_.size()) return;
+    Param& p = params_[idx];
+    p.s      = value;
+    p.length = static_cast<unsigned long>(p.s.size());
+    p.isNull = 0;
+
+    MYSQL_BIND& b = paramBinds_[idx];
+    std::memset(&b, 0, sizeof(b));
+    b.buffer_type   = MYSQL_TYPE_STRING;
+    b.buffer        = const_cast<char*>(p.s.data());
+    b.buffer_length = p.length;
+    b.length        = &p.length;
+    b.is_null       = &p.isNull;
+}
+
+void PreparedStatement::bindNull(unsigned idx) {
+    if (idx >= params_.size()) return;
+    params_[idx].isNull = 1;
+
+    MYSQL_BIND& b = paramBinds_[idx];
+    std::memset(&b, 0, sizeof(b));
+    b.buffer_type = MYSQL_TYPE_NULL;
+    b.is_null     = &params_[idx].isNull;
+}
+
+bool PreparedStatement::execute() {
+    if (!valid()) {
+        ok_ = false;
+        return false;
+    }
+    // 上一次的结果没读完也先丢掉
+    mysql_stmt_free_result(stmt_);
+
+    if (!params_.empty() && mysql_stmt_bind_param(stmt_, paramBinds_.data())) {
+        fail("bind_param");
+        return false;
+    }
+    if (mysql_stmt_execute(stmt_) != 0) {
+        fail("execute");
+        return false;
+    }
+    if (!columns_.empty()) {
+        if (rebind_ && !bindResult()) return false;
+        if (mysql_stmt_store_result(stmt_) != 0) {
+            fail("store_result");
+            return false;
+        }
+    }
+    ok_ = true;
+    return true;
+}
+
+bool PreparedStatement::fetch() {
+    if (!valid() || columns_.empty()) {
+        ok_ = valid();
+        return false;
+    }
+    if (rebind_ && !bindResult()) return false;
+
+    int rc = mysql_stmt_fetch(stmt_);
+    if (rc == MYSQL_NO_DATA) {
+        ok_ = true;
+        return false;
+    }
+    if (rc == 1) {
+        ok_ = false;
+        LOG_ERROR("[PreparedStatement::fetch] fetch failed: " << mysql_stmt_error(stmt_)
+                  << ", sql=" << sql_);
+        return false;
+    }
+
+    if (rc == MYSQL_DATA_TRUNCATED) {
+        // 字符串列放不下：按实际长度扩缓冲区，把这一列单独再取一次
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            Column& col = columns_[i];
+            if (col.isInt || !col.error || col.length <= col.buf.size()) continue;
+            col.buf.resize(col.length);
+            MYSQL_BIND& b = resultBinds_[i];
+            b.buffer        = col.buf.data();
+            b.buffer_length = static_cast<unsigned long>(col.buf.size());
+            if (mysql_stmt_fetch_column(stmt_, &b, static_cast<unsigned int>(i), 0) != 0) {
+                ok_ = false;
+                LOG_ERROR("[PreparedStatement::fetch] fetch column " << i << " failed: "
+                          << mysql_stmt_error(stmt_) << ", sql=" << sql_);
+                return false;
+            }
+            rebind_ = true;
+        }
+    }
+    ok_ = true;
+    return true;
+}
+
+bool PreparedStatement::isNull(unsigned col) const {
+    return col >= columns_.size() || columns_[col].isNull;
+}
+
+int64_t PreparedStatement::getInt(unsigned col) const {
+    if (isNull(col)) return 0;
+    const Column& c = columns_[col];
+    if (c.isInt) return c.i;
+    return std::atoll(std::string(c.buf.data(), std::min<size_t>(c.length, c.buf.size())).c_str());
+}
+
+std::string PreparedStatement::getString(unsigned col) const {
+    if (isNull(col)) return std::string();
+    const Column& c = columns_[col];
+    if (c.isInt) return std::to_string(c.i);
+    return std::string(c.buf.data(), std::min<size_t>(c.length, c.buf.size()));
+}
+
+uint64_t PreparedStatement::affectedRows() const {
+    return stmt_ ? static_cast<uint64_t>(mysql_stmt_affected_rows(stmt_)) : 0;
+}
+
+void PreparedStatement::fail(const char* what) {
+    ok_     = false;
+    broken_ = true;
+    LOG_ERROR("[PreparedStatement] " << what << " failed: " << mysql_stmt_error(stmt_)
+              << " (errno=" << mysql_stmt_errno(stmt_) << "), sql=" << sql_);
+}
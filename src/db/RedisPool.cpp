@@ -1,9 +1,12 @@
 #include "db/RedisPool.h"
 #include "core/Logger.h"
 #include <atomic>
+#include <chrono>
 
 namespace{
     std::atomic<bool> g_redisDown{false};  // ★★ 新增：全局 Redis 状态标志
+    // 连接全被借走时最多等多久，等不到就让调用方走降级逻辑，别把业务线程一直卡住
+    constexpr auto kGetConnTimeout = std::chrono::seconds(3);
 }
 
 RedisPool& RedisPool::Instance()
@@ -71,9 +74,10 @@ RedisConnPtr RedisPool::getConnection()
     }
 
     RedisConnPtr conn;
-    if (!pool_.Safepop(conn)) {
-        LOG_WARN("[RedisPool::getConnection] Safepop failed (pool empty or stopped)");
-        g_redisDown.store(true);          // ★★ 获取连接失败 → DOWN
+    if (!pool_.popFor(conn, kGetConnTimeout)) {
+        // 池子里的连接都被占着（Redis 本身没坏），不改 DOWN 标记
+        LOG_WARN("[RedisPool::getConnection] no idle connection within timeout, poolSize="
+                 << poolSize_);
         return nullptr;
     }
 
@@ -2,16 +2,26 @@
 #include "db/RedisPool.h"
 #include "core/ThreadPool.h"
 #include "db/DBpool.h"
+#include "chat/MessageWriter.h"
 #include <iostream>
 #include <csignal>
 
 static reactor* g_reactor = nullptr;
 static Server*  g_server  = nullptr;
+static volatile std::sig_atomic_t g_stopSignals = 0;
 
+// 热重启：新版本启动时从这里把监听 socket 要走，老版本排空连接后退出
+static const char* kHandoffPath = "/tmp/nebula-8888.sock";
+// 优雅关闭最多等多久（在途请求回完、outbuf 写完）
+static constexpr int64_t kDrainTimeoutMs = 10 * 1000;
+
+// 信号处理函数里只记一次信号、让主 reactor 退出循环（只碰 async-signal-safe 的东西：
+// sig_atomic_t、无锁 atomic、write eventfd；不打日志、不用 cout）。
+// 打印、优雅关闭（drain）和 Server::stop() 都放到 loop() 返回之后在 main 里做。
+// 第一次 Ctrl-C / SIGTERM 优雅关闭，drain 期间再来一次就不等了，直接关
 void handleSigint(int) {
-    std::cout << "\n[Ctrl-C] stopping server...\n";
-    if (g_server)  g_server->stop();
-    if (g_reactor) g_reactor->stop();
+    g_stopSignals = g_stopSignals + 1;
+    if (g_reactor) g_reactor->stopFromSignal();
 }
 
 int main() {
@@ -21,7 +31,7 @@ int main() {
         3306,           // port
         "root",         // user
         "1234",         // password
-        "serverlogin",  // database（确保已创建）
+        "serverlogin",  // database（确保已创建，表结构见 scripts/schema.sql）
         10              // pool size
     );
 
@@ -43,6 +53,9 @@ int main() {
     } 
     std::cout << "[main] RedisPool init OK\n";
 
+    // 聊天消息异步批量落库（两个写线程，最多一次占用两个 MySQL 连接）
+    chat::MessageWriter::Instance().start(2);
+
     // ① 创建 Reactor（事件循环）
     reactor rect(1024, true);
     g_reactor = &rect;
@@ -51,9 +64,10 @@ int main() {
     ThreadPool pool(4, 1024);
     pool.run();
 
-    // ③ 创建 Server
+    // ③ 创建 Server（IO 线程数默认取 CPU 核数，主 reactor 只负责 accept）
     Server server(rect, 8888, true, &pool);
     g_server = &server;
+    server.setHandoffPath(kHandoffPath);
 
     // ④ 启动 Server
     if (!server.start()) {
@@ -61,12 +75,29 @@ int main() {
         return -1;
     }
 
-    // ⑤ 注册 Ctrl+C
+    // ⑤ 注册 Ctrl+C / kill（部署工具一般发 SIGTERM）
     std::signal(SIGINT, handleSigint);
+    std::signal(SIGTERM, handleSigint);
+    // 对端已关闭时 write 会触发 SIGPIPE（默认直接杀进程），忽略掉，靠 write 返回 EPIPE 处理
+    std::signal(SIGPIPE, SIG_IGN);
 
     // ⑥ 开始事件循环
     std::cout << "Server is running on port 8888\n";
     rect.loop();
 
+    // 收到信号，或者监听 socket 已经交给了新进程：先排空老连接再退出
+    if (server.handedOff()) {
+        std::cout << "[main] listen socket handed over to the new process\n";
+    }
+    if (g_stopSignals > 0) {
+        std::cout << "\n[Ctrl-C] draining connections, press again to force stop...\n";
+    }
+    server.drain(kDrainTimeoutMs);
+    if (g_stopSignals > 1) {
+        std::cout << "[Ctrl-C] force stop\n";
+    }
+    server.stop();
+    // 连接都关了、不会再有新消息：把还没落库的写完
+    chat::MessageWriter::Instance().stop();
     return 0;
 }
@@ -0,0 +1,60 @@
+/*TimerWheel 回归测试：回调里取消同一个 tick 到期的其它定时器
+
+编译运行：cmake -DNEBULA_BUILD_TESTS=ON .. && make timer_wheel_test && ctest -R timer_wheel*/
+#include "core/TimerWheel.h"
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond)                                                          \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,      \
+                         __LINE__, #cond);                                   \
+            std::exit(1);                                                    \
+        }                                                                    \
+    } while (0)
+
+// 同一批里排在后面的定时器被前面的回调取消：不执行，也不泄漏 / 不崩
+static void cancelLaterInSameTick() {
+    TimerWheel w(10);
+    int fired1 = 0, fired2 = 0, fired3 = 0;
+    w.add(1, 0, 50, 0, [&] { ++fired1; CHECK(w.cancel(2)); CHECK(w.cancel(3)); });
+    w.add(2, 0, 50, 0, [&] { ++fired2; });
+    w.add(3, 0, 50, 0, [&] { ++fired3; });   // 链表最后一个节点
+    w.advance(100);
+    CHECK(fired1 == 1);
+    CHECK(fired2 == 0);
+    CHECK(fired3 == 0);
+    CHECK(w.size() == 0);
+    CHECK(!w.cancel(2));
+}
+
+// 周期定时器被同一批前面的回调取消：不再排下一次
+static void cancelPeriodicInSameTick() {
+    TimerWheel w(10);
+    int fired = 0;
+    w.add(1, 0, 30, 0, [&] { CHECK(w.cancel(2)); });
+    w.add(2, 0, 30, 30, [&] { ++fired; });
+    w.advance(200);
+    CHECK(fired == 0);
+    CHECK(w.size() == 0);
+}
+
+// 取消已经执行过的、同一批前面的定时器（一次性的已经释放）以及取消自己
+static void cancelEarlierAndSelf() {
+    TimerWheel w(10);
+    int fired = 0;
+    w.add(1, 0, 20, 0, [&] { ++fired; });
+    w.add(2, 0, 20, 20, [&] { ++fired; CHECK(!w.cancel(1)); CHECK(w.cancel(2)); });
+    w.advance(100);
+    CHECK(fired == 2);
+    CHECK(w.size() == 0);
+}
+
+int main() {
+    cancelLaterInSameTick();
+    cancelPeriodicInSameTick();
+    cancelEarlierAndSelf();
+    std::printf("timer_wheel_test OK\n");
+    return 0;
+}